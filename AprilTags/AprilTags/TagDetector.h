@@ -11,6 +11,32 @@
 
 namespace AprilTags {
 
+//! Time spent in each stage of the last extractTags call (in seconds) and what the stages produced
+struct TagDetectorStats {
+  double convert; //!< copy into the internal float image
+  double blur;
+  double gradient;
+  double edges;
+  double sort;
+  double merge;
+  double clusters;
+  double segments; //!< line fitting and linking of segments
+  double quads;
+  double decode;
+  double dedup;
+  double total;
+
+  int nEdges;
+  int nClusters;
+  int nSegments;
+  int nQuads;
+  int nDetections; //!< decoded quads, before removing duplicates
+  int nTags;
+
+  TagDetectorStats() { reset(); }
+  void reset();
+};
+
 class TagDetector {
 public:
 	
@@ -21,6 +47,9 @@ public:
 	TagDetector(const TagCodes& tagCodes) : thisTagFamily(tagCodes) {}
 	
 	std::vector<TagDetection> extractTags(const cv::Mat& image);
+
+	//! Filled in by every extractTags call
+	TagDetectorStats stats;
 	
 };
 
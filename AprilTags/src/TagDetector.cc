@@ -4,6 +4,7 @@
 #include <map>
 #include <vector>
 #include <iostream>
+#include <sys/time.h>
 
 #include <Eigen/Dense>
 
@@ -35,8 +36,25 @@ using namespace std;
 
 namespace AprilTags {
 
+  //! Current time in seconds, for timing the detection stages
+  static double stageClock() {
+    struct timeval t;
+    gettimeofday(&t, NULL);
+    return ((double)t.tv_sec + ((double)t.tv_usec)/1000000.);
+  }
+
+  void TagDetectorStats::reset() {
+    convert = blur = gradient = edges = sort = merge = clusters = segments = quads = decode = dedup = total = 0;
+    nEdges = nClusters = nSegments = nQuads = nDetections = nTags = 0;
+  }
+
   std::vector<TagDetection> TagDetector::extractTags(const cv::Mat& image) {
 
+    stats.reset();
+    double tStart = stageClock();
+    double tStage = tStart;
+    double tNow;
+
     // convert to internal AprilTags image (todo: slow, change internally to OpenCV)
     int width = image.cols;
     int height = image.rows;
@@ -49,6 +67,7 @@ namespace AprilTags {
       }
     }
     std::pair<int,int> opticalCenter(width/2, height/2);
+    tNow = stageClock(); stats.convert = tNow-tStage; tStage = tNow;
 
 #ifdef DEBUG_APRIL
 #if 0
@@ -145,6 +164,8 @@ namespace AprilTags {
     fimSeg = fimOrig;
   }
 
+  tNow = stageClock(); stats.blur = tNow-tStage; tStage = tNow;
+
   FloatImage fimTheta(fimSeg.getWidth(), fimSeg.getHeight());
   FloatImage fimMag(fimSeg.getWidth(), fimSeg.getHeight());
   
@@ -166,6 +187,7 @@ namespace AprilTags {
       fimMag.set(x, y, mag);
     }
   }
+  tNow = stageClock(); stats.gradient = tNow-tStage; tStage = tNow;
 
 #ifdef DEBUG_APRIL
   int height_ = fimSeg.getHeight();
@@ -232,9 +254,13 @@ namespace AprilTags {
     }
                   
     edges.resize(nEdges);
+    tNow = stageClock(); stats.edges = tNow-tStage; tStage = tNow;
     std::stable_sort(edges.begin(), edges.end());
+    tNow = stageClock(); stats.sort = tNow-tStage; tStage = tNow;
     Edge::mergeEdges(edges,uf,tmin,tmax,mmin,mmax);
+    tNow = stageClock(); stats.merge = tNow-tStage; tStage = tNow;
   }
+  stats.nEdges = nEdges;
           
   //================================================================
   // Step four: Loop over the pixels again, collecting statistics for each cluster.
@@ -257,6 +283,8 @@ namespace AprilTags {
       points.push_back(XYWeight(x,y,fimMag.get(x,y)));
     }
   }
+  stats.nClusters = clusters.size();
+  tNow = stageClock(); stats.clusters = tNow-tStage; tStage = tNow;
 
   //================================================================
   // Step five: Loop over the clusters, fitting lines (which we call Segments).
@@ -384,6 +412,8 @@ namespace AprilTags {
       parentseg.children.push_back(&child);
     }
   }
+  stats.nSegments = segments.size();
+  tNow = stageClock(); stats.segments = tNow-tStage; tStage = tNow;
 
   //================================================================
   // Step seven: Search all connected segments to see if any form a loop of length 4.
@@ -395,6 +425,8 @@ namespace AprilTags {
     tmp[0] = &segments[i];
     Quad::search(fimOrig, tmp, segments[i], 0, quads, opticalCenter);
   }
+  stats.nQuads = quads.size();
+  tNow = stageClock(); stats.quads = tNow-tStage; tStage = tNow;
 
 #ifdef DEBUG_APRIL
   {
@@ -528,6 +560,8 @@ namespace AprilTags {
       }
     }
   }
+  stats.nDetections = detections.size();
+  tNow = stageClock(); stats.decode = tNow-tStage; tStage = tNow;
 
 #ifdef DEBUG_APRIL
   {
@@ -577,8 +611,9 @@ namespace AprilTags {
 
   }
 
-  //cout << "AprilTags: edges=" << nEdges << " clusters=" << clusters.size() << " segments=" << segments.size()
-  //     << " quads=" << quads.size() << " detections=" << detections.size() << " unique tags=" << goodDetections.size() << endl;
+  stats.nTags = goodDetections.size();
+  tNow = stageClock(); stats.dedup = tNow-tStage;
+  stats.total = tNow-tStart;
 
   return goodDetections;
 }
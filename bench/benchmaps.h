@@ -0,0 +1,98 @@
+#ifndef BENCHMAPS_H
+#define BENCHMAPS_H
+//maps, synthetic detections and helpers shared by the benchmarks that run the planners without a camera
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include <algorithm>
+#include "opencv2/opencv.hpp"
+#include "pathplanners.h"
+
+//occupancy at cell resolution, 255 is free
+inline cv::Mat proceduralMap(const std::string &kind, int n, std::mt19937 &rng){
+  cv::Mat cells(n,n,CV_8UC1,cv::Scalar(255));
+  std::uniform_real_distribution<double> unit(0,1);
+  if(kind == "random"){
+    for(int r = 0;r<n;r++)
+      for(int c = 0;c<n;c++)
+        if(unit(rng) < 0.2)
+          cells.at<uchar>(r,c) = 0;
+  }
+  else if(kind == "rooms"){
+    //walls every room cells with a door in every wall segment
+    int room = std::max(4,n/5);
+    for(int w = room;w<n;w += room){
+      for(int i = 0;i<n;i++)
+        cells.at<uchar>(w,i) = cells.at<uchar>(i,w) = 0;
+      for(int s = 0;s<n;s += room){
+        int door = s+1+(int)(unit(rng)*(room-2));
+        if(door<n){
+          cells.at<uchar>(w,door) = 255;
+          cells.at<uchar>(door,w) = 255;
+        }
+      }
+    }
+  }
+  else if(kind != "empty"){
+    std::cout << "unknown map " << kind << std::endl;
+    exit(1);
+  }
+  return cells;
+}
+
+//gray image of n*cs pixels a side that overlayGrid turns into an n by n grid
+inline bool mapImage(const std::string &kind, int n, int cs, std::mt19937 &rng, cv::Mat &gray){
+  cv::Mat src;
+  if(kind == "empty" || kind == "random" || kind == "rooms"){
+    src = proceduralMap(kind,n,rng);
+    cv::resize(src,gray,cv::Size(n*cs,n*cs),0,0,cv::INTER_NEAREST);
+    return true;
+  }
+  src = cv::imread(kind,cv::IMREAD_GRAYSCALE);
+  if(src.empty())
+    return false;
+  cv::resize(src,gray,cv::Size(n*cs,n*cs),0,0,cv::INTER_AREA);
+  return true;
+}
+
+//a detection centered on the given grid cell, the corners are only used to mark the tag as free space
+inline AprilTags::TagDetection cellDetection(int id, int r, int c, int cs){
+  AprilTags::TagDetection d(id);
+  float x = c*cs+cs/2.0f, y = r*cs+cs/2.0f, h = cs/4.0f;
+  d.cxy = std::make_pair(x,y);
+  d.p[0] = std::make_pair(x-h,y+h);
+  d.p[1] = std::make_pair(x+h,y+h);
+  d.p[2] = std::make_pair(x+h,y-h);
+  d.p[3] = std::make_pair(x-h,y-h);
+  return d;
+}
+
+//free cells spread over the grid, in the order of the scan starting at the given fraction of the cells
+inline bool findFreeCell(PathPlannerGrid &plan, double start, int &r, int &c, std::vector<std::pair<int,int> > &taken){
+  int total = plan.rcells*plan.ccells;
+  for(int k = 0;k<total;k++){
+    int i = ((int)(start*total)+k)%total;
+    r = i/plan.ccells, c = i%plan.ccells;
+    if(!plan.isEmpty(r,c))
+      continue;
+    bool used = false;
+    for(int j = 0;j<taken.size();j++)
+      used |= taken[j].first == r && taken[j].second == c;
+    if(used)
+      continue;
+    taken.push_back(std::make_pair(r,c));
+    return true;
+  }
+  return false;
+}
+
+inline int coveredCells(std::vector<std::vector<nd> > &grid){
+  int n = 0;
+  for(int i = 0;i<grid.size();i++)
+    for(int j = 0;j<grid[i].size();j++)
+      n += grid[i][j].r_id >= 0;
+  return n;
+}
+#endif
@@ -0,0 +1,137 @@
+//round trips command frames from encodeCommandFrame through CommandFrameDecoder::feed a byte at a time,
+//including the cases the robots see on a noisy link, exits with 1 on a failed check
+#include <iostream>
+#include <string>
+#include <vector>
+#include "commandframe.h"
+using namespace std;
+
+static int failures = 0;
+
+static void check(bool ok, const string &what){
+  cout << (ok ? "ok    " : "FAIL  ") << what << endl;
+  if(!ok)
+    failures++;
+}
+
+static vector<unsigned char> encode(unsigned char seq, const vector<bot_command> &cmds){
+  vector<unsigned char> out(FRAME_OVERHEAD+3*cmds.size());
+  int len = encodeCommandFrame(seq,cmds.data(),cmds.size(),out.data());
+  out.resize(len<0 ? 0 : len);
+  return out;
+}
+
+//feeds bytes and returns the number of frames completed, the last one is left in the decoder
+static int feedAll(CommandFrameDecoder &dec, const vector<unsigned char> &bytes){
+  int frames = 0;
+  for(int i = 0;i<bytes.size();i++)
+    frames += dec.feed(bytes[i]);
+  return frames;
+}
+
+static bool same(const CommandFrameDecoder &dec, const vector<bot_command> &cmds){
+  if(dec.count != cmds.size())
+    return false;
+  for(int i = 0;i<cmds.size();i++)
+    if(dec.commands[i].id != cmds[i].id || dec.commands[i].left != cmds[i].left || dec.commands[i].right != cmds[i].right)
+      return false;
+  return true;
+}
+
+int main(){
+  vector<bot_command> buf(FRAME_MAX_COMMANDS);
+  vector<bot_command> cmds;
+  bot_command c;
+  for(int i = 0;i<4;i++){
+    c.id = 3+i;
+    c.left = -20*i;
+    c.right = 30*i;
+    cmds.push_back(c);
+  }
+
+  {
+    CommandFrameDecoder dec(buf.data(),buf.size());
+    vector<unsigned char> frame = encode(7,cmds);
+    check(frame.size() == FRAME_OVERHEAD+3*cmds.size(),"the frame is FRAME_OVERHEAD+3n bytes");
+    check(feedAll(dec,frame) == 1 && same(dec,cmds) && dec.seq == 7,"a frame decodes to the commands and sequence number sent");
+  }
+
+  {
+    CommandFrameDecoder dec(buf.data(),buf.size());
+    vector<unsigned char> frame = encode(0,vector<bot_command>());
+    check(frame.size() == FRAME_OVERHEAD && feedAll(dec,frame) == 1 && dec.count == 0,"n=0 sends and decodes an empty frame");
+  }
+
+  {
+    vector<bot_command> all;
+    for(int i = 0;i<FRAME_MAX_COMMANDS;i++){
+      c.id = i;
+      c.left = i-128;
+      c.right = 127-i;
+      all.push_back(c);
+    }
+    CommandFrameDecoder dec(buf.data(),buf.size());
+    vector<unsigned char> frame = encode(255,all);
+    check(frame.size() == FRAME_MAX_SIZE && feedAll(dec,frame) == 1 && same(dec,all) && dec.seq == 255,"n=255 decodes every command");
+    all.push_back(c);
+    unsigned char out[FRAME_MAX_SIZE+3];
+    check(encodeCommandFrame(0,all.data(),all.size(),out) == -1,"n=256 is refused");
+  }
+
+  {
+    vector<bot_command> wide(1);
+    wide[0].id = 1;
+    wide[0].left = 500;
+    wide[0].right = -500;
+    CommandFrameDecoder dec(buf.data(),buf.size());
+    feedAll(dec,encode(1,wide));
+    check(dec.count == 1 && dec.commands[0].left == 127 && dec.commands[0].right == -128,"velocities are clamped to a byte");
+  }
+
+  {
+    //0x7E as an id and both velocities, on a link joined in the middle of that frame
+    vector<bot_command> starts(cmds);
+    starts[1].id = FRAME_START;
+    starts[1].left = FRAME_START-128;
+    starts[1].right = FRAME_START-128;
+    vector<unsigned char> a = encode(1,starts), b = encode(2,cmds);
+    CommandFrameDecoder dec(buf.data(),buf.size());
+    check(feedAll(dec,a) == 1 && same(dec,starts),"start bytes in the payload of a frame followed from its start are data");
+    vector<unsigned char> joined(a.begin()+4,a.end());
+    joined.insert(joined.end(),b.begin(),b.end());
+    CommandFrameDecoder late(buf.data(),buf.size());
+    check(feedAll(late,joined) == 1 && same(late,cmds) && late.seq == 2,"a false start in the payload doesn't swallow the next frame");
+    check(late.crc_errors>0,"the false start is counted as a crc error");
+  }
+
+  {
+    vector<unsigned char> a = encode(1,cmds), b = encode(2,cmds);
+    a[6] ^= 0x10;
+    vector<unsigned char> stream(a);
+    stream.insert(stream.end(),b.begin(),b.end());
+    CommandFrameDecoder dec(buf.data(),buf.size());
+    check(feedAll(dec,stream) == 1 && dec.seq == 2 && dec.crc_errors == 1,"a corrupted payload byte drops only its frame");
+    a = encode(1,cmds);
+    a.back() ^= 0x01;
+    stream = a;
+    stream.insert(stream.end(),b.begin(),b.end());
+    CommandFrameDecoder dec2(buf.data(),buf.size());
+    check(feedAll(dec2,stream) == 1 && dec2.seq == 2 && dec2.crc_errors == 1,"a corrupted crc byte drops only its frame");
+    a = encode(1,cmds);
+    a[3] ^= 0x01;
+    stream = a;
+    stream.insert(stream.end(),b.begin(),b.end());
+    CommandFrameDecoder dec3(buf.data(),buf.size());
+    check(feedAll(dec3,stream) == 1 && dec3.seq == 2 && dec3.crc_errors>0,"a corrupted header crc drops only its frame");
+  }
+
+  {
+    bot_command mine;
+    CommandFrameDecoder dec(&mine,1,cmds[2].id);
+    check(feedAll(dec,encode(3,cmds)) == 1 && dec.count == 1 && mine.id == cmds[2].id && mine.left == cmds[2].left,"a robot's decoder keeps only its own command");
+  }
+
+  if(failures)
+    cout << failures << " checks failed" << endl;
+  return failures ? 1 : 0;
+}
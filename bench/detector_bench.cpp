@@ -0,0 +1,301 @@
+//renders synthetic frames with tags at known poses and measures speed, per stage time and recall of the tag detector
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <random>
+#include <cmath>
+#include <cstdlib>
+#include <unistd.h>
+#include <Eigen/Dense>
+#include "opencv2/opencv.hpp"
+#include "AprilTags/TagDetector.h"
+#include "AprilTags/Tag16h5.h"
+#include "AprilTags/Tag25h7.h"
+#include "AprilTags/Tag25h9.h"
+#include "AprilTags/Tag36h9.h"
+#include "AprilTags/Tag36h11.h"
+#include "aprilvideointerface.h"//tic
+#include "profiling.h"
+using namespace std;
+
+const string usage = "\n"
+  "Usage:\n"
+  "  detector_bench [OPTION...]\n"
+  "\n"
+  "Options:\n"
+  "  -h  -?          Show help options\n"
+  "  -C <bbxhh>      Tag family (default 36h11), 'all' for every family\n"
+  "  -n <frames>     Frames per configuration (default 30)\n"
+  "  -k <tags>       Tags per frame (default 6)\n"
+  "  -r <WxH>        Resolution, may be repeated (default 320x240, 640x480 and 1280x960)\n"
+  "  -b <sigma>      Gaussian blur sigma in pixels, may be repeated (default 0 and 1.5)\n"
+  "  -g <std>        Gaussian noise std in gray levels, may be repeated (default 0 and 8)\n"
+  "  -t <degrees>    Maximum out of plane tilt (default 40)\n"
+  "  -s <seed>       Random seed (default 1)\n"
+  "  -o <file>       Write the results as csv\n"
+  "  -w              Save the first frame of every configuration as png\n"
+  "  -v              Print the full stage table of every configuration\n"
+  "\n";
+
+struct tag_truth{
+  int id;
+  double cx, cy;//center in pixels
+  double size;//side of the black square in pixels(approximate under tilt)
+};
+
+struct bench_config{
+  string family;
+  int width, height;
+  double blur, noise;
+};
+
+//pixel value of the tag at tag coordinates(u,v), the black square spans [-1,1], -1 if outside the white border
+//bits are laid out row major with the most significant bit in the top left corner(v = -1 is the top)
+static int tagValue(double u, double v, unsigned long long code, int dim){
+  int cells = dim+2;//black border included
+  double cell = 2.0/cells;
+  int cx = (int)floor((u+1)/cell), cy = (int)floor((v+1)/cell);
+  if(cx < -1 || cy < -1 || cx > cells || cy > cells)
+    return -1;
+  if(cx == -1 || cy == -1 || cx == cells || cy == cells)
+    return 1;//white border
+  if(cx == 0 || cy == 0 || cx == cells-1 || cy == cells-1)
+    return 0;//black border
+  int bit = dim*dim-1-((cy-1)*dim+(cx-1));
+  return (code>>bit)&1;
+}
+
+//homography from tag coordinates to pixels for a tag of side size pixels centered at (cx,cy), rotated by
+//theta in the image plane and tilted by ax, ay out of it, seen by a camera with focal length f
+static Eigen::Matrix3d tagHomography(double cx, double cy, double size, double theta, double ax, double ay, double f){
+  Eigen::Matrix3d R;
+  R = Eigen::AngleAxisd(theta,Eigen::Vector3d::UnitZ())*Eigen::AngleAxisd(ay,Eigen::Vector3d::UnitY())*Eigen::AngleAxisd(ax,Eigen::Vector3d::UnitX());
+  Eigen::Matrix3d K;
+  K << f, 0, cx,
+       0, f, cy,
+       0, 0, 1;
+  Eigen::Matrix3d M;
+  M.col(0) = R.col(0)*size/2;
+  M.col(1) = R.col(1)*size/2;
+  M.col(2) = Eigen::Vector3d(0,0,f);//the tag sits at depth f so that size is its side in pixels
+  return K*M;
+}
+
+static Eigen::Vector2d project(const Eigen::Matrix3d &H, double u, double v){
+  Eigen::Vector3d p = H*Eigen::Vector3d(u,v,1);
+  return Eigen::Vector2d(p(0)/p(2),p(1)/p(2));
+}
+
+//draws the tag into the image with 2x2 supersampling
+static void renderTag(cv::Mat &image, const Eigen::Matrix3d &H, unsigned long long code, int dim, int black, int white){
+  double outer = 1+2.0/(dim+2);//the white border is one cell wide
+  double x0 = image.cols, y0 = image.rows, x1 = 0, y1 = 0;
+  for(int i = 0;i<4;i++){
+    Eigen::Vector2d p = project(H,i&1 ? outer : -outer,i&2 ? outer : -outer);
+    x0 = min(x0,p(0)), y0 = min(y0,p(1)), x1 = max(x1,p(0)), y1 = max(y1,p(1));
+  }
+  Eigen::Matrix3d Hinv = H.inverse();
+  for(int y = max(0,(int)y0);y<=min(image.rows-1,(int)y1);y++){
+    unsigned char *row = image.ptr(y);
+    for(int x = max(0,(int)x0);x<=min(image.cols-1,(int)x1);x++){
+      int sum = 0, inside = 0;
+      for(int s = 0;s<4;s++){
+        Eigen::Vector3d t = Hinv*Eigen::Vector3d(x+0.25+0.5*(s&1),y+0.25+0.5*(s>>1),1);
+        int v = tagValue(t(0)/t(2),t(1)/t(2),code,dim);
+        if(v<0)
+          continue;
+        sum += v ? white : black;
+        inside++;
+      }
+      if(inside)
+        row[x] = (sum+row[x]*(4-inside))/4;
+    }
+  }
+}
+
+//renders a frame with k tags, one per cell of a grid so that they don't overlap
+static void renderScene(cv::Mat &image, const AprilTags::TagCodes &codes, int k, double max_tilt, mt19937 &rng, vector<tag_truth> &truth){
+  uniform_real_distribution<double> unit(0,1);
+  //smooth background so that the only strong edges belong to the tags
+  for(int y = 0;y<image.rows;y++){
+    unsigned char *row = image.ptr(y);
+    for(int x = 0;x<image.cols;x++)
+      row[x] = 110+70*x/image.cols+30*y/image.rows;
+  }
+  int dim = (int)sqrt((double)codes.bits);
+  int grid_c = (int)ceil(sqrt((double)k)), grid_r = (k+grid_c-1)/grid_c;
+  double cw = (double)image.cols/grid_c, ch = (double)image.rows/grid_r;
+  double f = image.cols;
+  truth.clear();
+  for(int i = 0;i<k;i++){
+    tag_truth t;
+    t.id = (int)(unit(rng)*codes.codes.size())%codes.codes.size();
+    //the tag with its white border must stay inside its cell at any rotation
+    double span = min(cw,ch)/(sqrt(2.0)*(1+2.0/(dim+2)));
+    t.size = span*(0.35+0.5*unit(rng));
+    double slack = span-t.size;
+    t.cx = (i%grid_c+0.5)*cw+(unit(rng)-0.5)*slack*0.5;
+    t.cy = (i/grid_c+0.5)*ch+(unit(rng)-0.5)*slack*0.5;
+    double theta = unit(rng)*2*M_PI;
+    double ax = (unit(rng)*2-1)*max_tilt*M_PI/180, ay = (unit(rng)*2-1)*max_tilt*M_PI/180;
+    Eigen::Matrix3d H = tagHomography(t.cx,t.cy,t.size,theta,ax,ay,f);
+    Eigen::Vector2d c = project(H,0,0);
+    t.cx = c(0), t.cy = c(1);
+    renderTag(image,H,codes.codes[t.id],dim,25,235);
+    truth.push_back(t);
+  }
+}
+
+static void degrade(cv::Mat &image, double blur, double noise){
+  if(blur > 0)
+    cv::GaussianBlur(image,image,cv::Size(0,0),blur);
+  if(noise > 0){
+    cv::Mat noisy, n(image.rows,image.cols,CV_16SC1);
+    cv::randn(n,cv::Scalar(0),cv::Scalar(noise));
+    image.convertTo(noisy,CV_16SC1);
+    cv::add(noisy,n,noisy);
+    noisy.convertTo(image,CV_8UC1);//saturates
+  }
+}
+
+static const AprilTags::TagCodes& familyCodes(const string &s){
+  if(s == "16h5") return AprilTags::tagCodes16h5;
+  if(s == "25h7") return AprilTags::tagCodes25h7;
+  if(s == "25h9") return AprilTags::tagCodes25h9;
+  if(s == "36h9") return AprilTags::tagCodes36h9;
+  if(s == "36h11") return AprilTags::tagCodes36h11;
+  cout << "Invalid tag family specified" << endl;
+  exit(1);
+}
+
+int main(int argc, char* argv[]){
+  vector<string> families;
+  vector<pair<int,int> > resolutions;
+  vector<double> blurs, noises;
+  int frames = 30, k = 6;
+  double max_tilt = 40;
+  unsigned seed = 1;
+  string csv_path;
+  bool save = false, verbose = false;
+  int c;
+  while((c = getopt(argc,argv,":h?C:n:k:r:b:g:t:s:o:wv")) != -1){
+    switch(c){
+      case 'h':
+      case '?':
+        cout << usage;
+        exit(0);
+      case 'C':
+        if(string(optarg) == "all"){
+          const char *all[] = {"16h5","25h7","25h9","36h9","36h11"};
+          families.assign(all,all+5);
+        }
+        else
+          families.push_back(optarg);
+        break;
+      case 'n': frames = atoi(optarg); break;
+      case 'k': k = atoi(optarg); break;
+      case 'r':{
+        int w, h;
+        if(sscanf(optarg,"%dx%d",&w,&h) != 2){
+          cout << usage;
+          exit(1);
+        }
+        resolutions.push_back(make_pair(w,h));
+        break;
+      }
+      case 'b': blurs.push_back(atof(optarg)); break;
+      case 'g': noises.push_back(atof(optarg)); break;
+      case 't': max_tilt = atof(optarg); break;
+      case 's': seed = atoi(optarg); break;
+      case 'o': csv_path = optarg; break;
+      case 'w': save = true; break;
+      case 'v': verbose = true; break;
+      case ':':
+        cout << usage;
+        exit(1);
+    }
+  }
+  if(families.empty()) families.push_back("36h11");
+  if(resolutions.empty()){
+    resolutions.push_back(make_pair(320,240));
+    resolutions.push_back(make_pair(640,480));
+    resolutions.push_back(make_pair(1280,960));
+  }
+  if(blurs.empty()){ blurs.push_back(0); blurs.push_back(1.5); }
+  if(noises.empty()){ noises.push_back(0); noises.push_back(8); }
+
+  ofstream csv;
+  if(!csv_path.empty()){
+    csv.open(csv_path.c_str());
+    csv << "family,width,height,blur,noise,frames,fps,recall,false_positives";
+    for(int i = 0;i<DetectorProfiler::STAGES;i++)
+      csv << "," << DetectorProfiler::stage_names[i] << "_p50_ms";
+    csv << endl;
+  }
+  cout << "family  resolution  blur noise    fps  recall  false+  p50 ms  p99 ms" << endl;
+  for(int fi = 0;fi<families.size();fi++){
+    const AprilTags::TagCodes &codes = familyCodes(families[fi]);
+    AprilTags::TagDetector detector(codes);
+    for(int ri = 0;ri<resolutions.size();ri++)
+    for(int bi = 0;bi<blurs.size();bi++)
+    for(int ni = 0;ni<noises.size();ni++){
+      bench_config cfg = {families[fi],resolutions[ri].first,resolutions[ri].second,blurs[bi],noises[ni]};
+      //every configuration sees the same sequence of scenes
+      mt19937 rng(seed);
+      cv::Mat image(cfg.height,cfg.width,CV_8UC1);
+      vector<tag_truth> truth;
+      DetectorProfiler profiler;
+      Histogram frame_time;//timed around extractTags, so that it doesn't rely on the detector's own counters
+      int expected = 0, found = 0, false_positives = 0;
+      double busy = 0;
+      for(int frame = 0;frame<frames;frame++){
+        renderScene(image,codes,k,max_tilt,rng,truth);
+        degrade(image,cfg.blur,cfg.noise);
+        if(save && frame == 0){
+          ostringstream name;
+          name << "bench_" << cfg.family << "_" << cfg.width << "x" << cfg.height << "_b" << cfg.blur << "_n" << cfg.noise << ".png";
+          cv::imwrite(name.str(),image);
+        }
+        double t0 = tic();
+        vector<AprilTags::TagDetection> dets = detector.extractTags(image);
+        double dt = tic()-t0;
+        frame_time.add(dt);
+        busy += dt;
+        profiler.add(detector.stats);//the time of every stage
+        //a tag counts as found if a detection with its id lies within a quarter of its size of its center
+        vector<char> used(dets.size(),0);
+        for(int i = 0;i<truth.size();i++){
+          expected++;
+          for(int j = 0;j<dets.size();j++){
+            double dx = dets[j].cxy.first-truth[i].cx, dy = dets[j].cxy.second-truth[i].cy;
+            if(!used[j] && dets[j].id == truth[i].id && dx*dx+dy*dy < truth[i].size*truth[i].size/16){
+              used[j] = 1;
+              found++;
+              break;
+            }
+          }
+        }
+        for(int j = 0;j<dets.size();j++)
+          false_positives += !used[j];
+      }
+      double fps = busy > 0 ? frames/busy : 0;
+      double recall = expected ? (double)found/expected : 0;
+      cout << setw(6) << cfg.family << setw(6) << cfg.width << "x" << setw(5) << left << cfg.height << right
+           << setw(5) << cfg.blur << setw(6) << cfg.noise << setw(7) << setprecision(4) << fps
+           << setw(8) << recall << setw(8) << false_positives
+           << setw(8) << 1000*frame_time.percentile(0.5)
+           << setw(8) << 1000*frame_time.percentile(0.99) << endl;
+      if(verbose)
+        profiler.print(cout);
+      if(csv.is_open()){
+        csv << cfg.family << "," << cfg.width << "," << cfg.height << "," << cfg.blur << "," << cfg.noise << "," << frames << ","
+            << fps << "," << recall << "," << false_positives;
+        for(int i = 0;i<DetectorProfiler::STAGES;i++)
+          csv << "," << 1000*profiler.stage(i).percentile(0.5);
+        csv << endl;
+      }
+    }
+  }
+  return 0;
+}
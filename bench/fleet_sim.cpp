@@ -0,0 +1,258 @@
+//closed loop simulation of a fleet of differential drive robots covering a map, runs the same
+//BSACoverageIncremental planner and pure pursuit controller as the sandbox, faster than real time
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <random>
+#include <deque>
+#include <cmath>
+#include <cstdlib>
+#include <unistd.h>
+#include "opencv2/opencv.hpp"
+#include "aprilvideointerface.h"//tic
+#include "pathplanners.h"
+#include "fleet.h"
+#include "controllers.h"
+#include "profiling.h"
+#include "benchmaps.h"
+using namespace std;
+
+const string usage = "\n"
+  "Usage:\n"
+  "  fleet_sim [OPTION...]\n"
+  "\n"
+  "Options:\n"
+  "  -h  -?          Show help options\n"
+  "  -r <robots>     Fleet size, may be repeated (default 10)\n"
+  "  -m <map>        empty, random, rooms or an image file (default rooms)\n"
+  "  -n <cells>      Grid side in cells (default 30)\n"
+  "  -c <size>       Cell side in world units, the camera is simulated with one pixel per unit (default 30)\n"
+  "  -f <fps>        Camera frame rate, the planner and controller run once per frame (default 30)\n"
+  "  -u <scale>      World units per second of one wheel velocity unit (default 0.2)\n"
+  "  -g <sigma>      Standard deviation of the pose noise of the simulated detections(default 0)\n"
+  "  -l <seconds>    Latency from computing a command to the robot acting on it (default 0)\n"
+  "  -k              Compensate the latency in the controllers(predictPose)\n"
+  "  -j <threads>    Plan the robots in parallel on this many threads as the sandbox does with -j (default 1)\n"
+  "  -w <points>     Plan this many spiral points ahead of every robot as the sandbox does with -w (default 1)\n"
+  "  -T <seconds>    Give up after this much simulated time (default 3600)\n"
+  "  -s <seed>       Random seed (default 1)\n"
+  "  -o <file>       Write the results as csv\n"
+  "  -v              Keep the planners' own output\n"
+  "\n";
+
+struct sim_result{
+  int robots;
+  long ticks;
+  long stalled;//robot ticks without a target while there was still something to cover
+  double sim_time, wall_time;
+  bool completed;
+  int covered, free_cells;
+  Histogram plan, control;
+};
+
+int main(int argc, char* argv[]){
+  vector<int> fleet_sizes;
+  string map_kind = "rooms";
+  int n = 30, cs = 30;
+  double fps = 30, velocity_scale = 0.2, noise = 0, max_time = 3600, latency = 0;
+  bool compensate = false;
+  int plan_threads = 1, lookahead = 1;
+  unsigned seed = 1;
+  string csv_path;
+  bool verbose = false;
+  int opt;
+  while((opt = getopt(argc,argv,":h?r:m:n:c:f:u:g:l:kj:w:T:s:o:v")) != -1){
+    switch(opt){
+      case 'h':
+      case '?':
+        cout << usage;
+        exit(0);
+      case 'r': fleet_sizes.push_back(atoi(optarg)); break;
+      case 'm': map_kind = optarg; break;
+      case 'n': n = atoi(optarg); break;
+      case 'c': cs = atoi(optarg); break;
+      case 'f': fps = atof(optarg); break;
+      case 'u': velocity_scale = atof(optarg); break;
+      case 'g': noise = atof(optarg); break;
+      case 'l': latency = atof(optarg); break;
+      case 'k': compensate = true; break;
+      case 'j': plan_threads = atoi(optarg); break;
+      case 'w': lookahead = max(1,atoi(optarg)); break;
+      case 'T': max_time = atof(optarg); break;
+      case 's': seed = atoi(optarg); break;
+      case 'o': csv_path = optarg; break;
+      case 'v': verbose = true; break;
+      case ':':
+        cout << usage;
+        exit(1);
+    }
+  }
+  if(fleet_sizes.empty())
+    fleet_sizes.push_back(10);
+
+  if(!verbose)
+    Telemetry::instance().open("");//discard the planners' messages
+
+  vector<sim_result> results;
+  double dt = 1/fps;
+  for(int fi = 0;fi<fleet_sizes.size();fi++){
+    int n_bots = fleet_sizes[fi];
+    mt19937 rng(seed);
+    normal_distribution<double> gauss(0,1);
+    cv::Mat gray;
+    if(!mapImage(map_kind,n,cs,rng,gray)){
+      cout << "can't read map " << map_kind << endl;
+      return 1;
+    }
+    //same parameters as the sandbox, bot 0 stands for the origin tag
+    vector<vector<nd> > grid;
+    vector<bot_config> bots(n_bots+1,bot_config(cs,cs,120,grid,40.0,2.3,14.5,75,75,128,false));
+    vector<AprilTags::TagDetection> none;
+    bots[0].plan.overlayGrid(none,gray);
+    int free_cells = 0;
+    for(int r = 0;r<bots[0].plan.rcells;r++)
+      for(int c = 0;c<bots[0].plan.ccells;c++)
+        free_cells += bots[0].plan.isEmpty(r,c);
+
+    //the world is the image plane, so the simulated detections are the poses themselves
+    HomographyMapping world;
+    vector<pair<int,int> > taken;
+    vector<robot_pose> truth(n_bots+1);
+    int r, c;
+    bool placed = findFreeCell(bots[0].plan,0,r,c,taken);
+    world.detections.push_back(cellDetection(0,r,c,cs));
+    for(int i = 1;placed && i<=n_bots;i++){
+      placed = findFreeCell(bots[0].plan,(double)i/(n_bots+1),r,c,taken);
+      world.detections.push_back(cellDetection(i,r,c,cs));
+      truth[i].x = world.detections[i].cxy.first;
+      truth[i].y = world.detections[i].cxy.second;
+      truth[i].omega = ((int)(rng()%4)-1)*PI/2;
+    }
+    if(!placed){
+      cout << "not enough free cells for " << n_bots << " robots" << endl;
+      continue;
+    }
+    for(int i = 0;i<bots.size();i++){
+      bots[i].id = bots[i].plan.robot_tag_id = bots[i].plan.robot_id = i;//detection index and tag id are the same
+      bots[i].plan.rcells = bots[0].plan.rcells;
+      bots[i].plan.ccells = bots[0].plan.ccells;
+      bots[i].plan.origin_id = 0;
+      bots[i].plan.lookahead = lookahead;
+      if(compensate){
+        bots[i].control.latency = latency;
+        bots[i].control.velocity_scale = velocity_scale;
+      }
+    }
+    //commands on their way to the robots, they act latency seconds after they were computed
+    vector<deque<timed_command> > in_flight(bots.size());
+    vector<pair<int,int> > acting(bots.size(),make_pair(0,0));
+
+    sim_result res;
+    res.robots = n_bots;
+    res.free_cells = free_cells;
+    res.completed = false;
+    res.stalled = 0;
+    vector<char> planned(bots.size(),0);//planner has no uncovered cell left for the robot
+    FleetPlanner fleet_planner(plan_threads);
+    fleet_stimuli fleet;
+    long tick = 0;
+    double sim_t = 0, wall_start = tic();
+    while(sim_t < max_time){
+      //camera: every robot is seen at its true pose plus noise
+      for(int i = 1;i<bots.size();i++){
+        robot_pose &seen = bots[i].pose;
+        seen.x = truth[i].x+noise*gauss(rng);
+        seen.y = truth[i].y+noise*gauss(rng);
+        seen.omega = truth[i].omega+noise/bots[i].control.axle_length*gauss(rng);//tag about as wide as the axle
+        world.detections[i].cxy = make_pair((float)seen.x,(float)seen.y);
+      }
+      double t0 = tic();
+      if(plan_threads != 1)
+        fleet_planner.plan(bots,world,2.5);//robots with nothing left to cover stay idle
+      for(int i = 1;i<bots.size();i++){
+        if(planned[i])
+          continue;
+        PathPlannerGrid &plan = bots[i].plan;
+        if(plan_threads == 1)
+          plan.BSACoverageIncremental(world,bots[i].pose,2.5,bots);
+        planned[i] = !plan.first_call && plan.sk.empty();//no backtracking point left, calling again is not allowed
+      }
+      double t1 = tic();
+      fleet.resize(bots.size());
+      bool moving = false;
+      for(int i = 1;i<bots.size();i++){
+        vector<pt> &path = bots[i].plan.path_points;
+        robot_pose pose = bots[i].control.predictPose(bots[i].pose,sim_t,sim_t);
+        int next_point = bots[i].control.findNextPoint(pose,path);
+        fleet.x[i] = pose.x, fleet.y[i] = pose.y, fleet.omega[i] = pose.omega;
+        if(next_point == path.size()){
+          res.stalled += !planned[i];
+          continue;
+        }
+        fleet.tx[i] = path[next_point].x, fleet.ty[i] = path[next_point].y;
+        fleet.active[i] = 1;
+        moving = true;
+      }
+      bots[0].control.computeFleetStimuli(fleet);
+      double t2 = tic();
+      res.plan.add(t1-t0);
+      res.control.add(t2-t1);
+      //robots are points, they drive through each other and through walls if the controller overshoots
+      for(int i = 1;i<bots.size();i++){
+        bots[i].control.recordCommand(fleet.left[i],fleet.right[i],sim_t);
+        in_flight[i].push_back(timed_command(sim_t+latency,fleet.left[i],fleet.right[i]));
+        double t = sim_t;
+        while(!in_flight[i].empty() && in_flight[i].front().t<sim_t+dt){
+          timed_command &cmd = in_flight[i].front();
+          if(cmd.t>t){
+            integrateUnicycle(truth[i],acting[i].first,acting[i].second,bots[i].control.axle_length,velocity_scale,cmd.t-t);
+            t = cmd.t;
+          }
+          acting[i] = make_pair(cmd.left,cmd.right);
+          in_flight[i].pop_front();
+        }
+        integrateUnicycle(truth[i],acting[i].first,acting[i].second,bots[i].control.axle_length,velocity_scale,sim_t+dt-t);
+        if(acting[i].first || acting[i].second)
+          moving = true;//still coasting on a command sent before the path ended
+      }
+      tick++;
+      sim_t += dt;
+      bool all_planned = true;
+      for(int i = 1;i<bots.size();i++)
+        all_planned &= planned[i] != 0;
+      if(all_planned && !moving){
+        res.completed = true;
+        break;
+      }
+    }
+    res.ticks = tick;
+    res.sim_time = sim_t;
+    res.wall_time = tic()-wall_start;
+    res.covered = coveredCells(grid);
+    results.push_back(res);
+
+    cout << n_bots << " robots on " << map_kind << " " << n << "x" << n;
+    if(latency > 0)
+      cout << " with " << latency << " s latency" << (compensate ? " compensated" : "");
+    cout << ": "
+        << (res.completed ? "covered " : "gave up with ") << res.covered << " of " << res.free_cells << " free cells"
+        << " in " << fixed << setprecision(1) << res.sim_time << " s simulated, " << setprecision(3) << res.wall_time << " s wall"
+        << ", " << setprecision(1) << res.sim_time/res.wall_time << "x real time" << endl;
+    cout << "  per tick  plan mean " << setprecision(3) << res.plan.mean()*1000 << " ms p99 " << res.plan.percentile(0.99)*1000
+        << " max " << res.plan.max()*1000 << " ms, control mean " << res.control.mean()*1000 << " ms p99 " << res.control.percentile(0.99)*1000 << " ms" << endl;
+    cout << "  stalled waiting for a target " << setprecision(1) << 100.*res.stalled/max(1L,res.ticks*n_bots) << "% of robot ticks" << endl;
+    cout.unsetf(ios::floatfield);
+  }
+
+  if(!csv_path.empty()){
+    ofstream csv(csv_path.c_str());
+    csv << "robots,latency_s,compensated,completed,ticks,stalled,sim_s,wall_s,covered,free_cells,plan_mean_ms,plan_p99_ms,plan_max_ms,control_mean_ms,control_p99_ms" << endl;
+    for(int i = 0;i<results.size();i++){
+      sim_result &r = results[i];
+      csv << r.robots << "," << latency << "," << compensate << "," << r.completed << "," << r.ticks << "," << r.stalled << "," << r.sim_time << "," << r.wall_time << ","
+          << r.covered << "," << r.free_cells << "," << r.plan.mean()*1000 << "," << r.plan.percentile(0.99)*1000 << ","
+          << r.plan.max()*1000 << "," << r.control.mean()*1000 << "," << r.control.percentile(0.99)*1000 << endl;
+    }
+  }
+  return 0;
+}
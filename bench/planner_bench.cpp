@@ -0,0 +1,201 @@
+//times the grid planners on procedural and image derived maps of growing size, no camera needed
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <random>
+#include <cstdlib>
+#include <unistd.h>
+#include "opencv2/opencv.hpp"
+#include "aprilvideointerface.h"//tic
+#include "pathplanners.h"
+#include "benchmaps.h"
+using namespace std;
+
+const string usage = "\n"
+  "Usage:\n"
+  "  planner_bench [OPTION...]\n"
+  "\n"
+  "Options:\n"
+  "  -h  -?          Show help options\n"
+  "  -n <cells>      Grid side in cells, may be repeated (default 10, 30, 100, 300 and 1000)\n"
+  "  -m <map>        empty, random, rooms or an image file, may be repeated\n"
+  "                  (default empty, random, rooms and sandbox/land.png if found)\n"
+  "  -b <bots>       Robots for the incremental multi robot coverage (default 3)\n"
+  "  -c <cells>      Largest grid side for the coverage planners (default 300), larger grids only run findshortest\n"
+  "  -i <cells>      Largest grid side for the incremental multi robot coverage (default 100), every backtracking\n"
+  "                  point it keeps holds a copy of the stack, so its memory grows with the fourth power of the side\n"
+  "  -s <seed>       Random seed (default 1)\n"
+  "  -o <file>       Write the results as csv\n"
+  "  -v              Keep the planners' own output\n"
+  "\n";
+
+struct bench_result{
+  string map, planner;
+  int cells;
+  double ms;
+  int path_points, covered;
+};
+
+int main(int argc, char* argv[]){
+  vector<int> sizes;
+  vector<string> maps;
+  int n_bots = 3, coverage_limit = 300, incremental_limit = 100;
+  unsigned seed = 1;
+  string csv_path;
+  bool verbose = false;
+  int opt;
+  while((opt = getopt(argc,argv,":h?n:m:b:c:i:s:o:v")) != -1){
+    switch(opt){
+      case 'h':
+      case '?':
+        cout << usage;
+        exit(0);
+      case 'n': sizes.push_back(atoi(optarg)); break;
+      case 'm': maps.push_back(optarg); break;
+      case 'b': n_bots = atoi(optarg); break;
+      case 'c': coverage_limit = atoi(optarg); break;
+      case 'i': incremental_limit = atoi(optarg); break;
+      case 's': seed = atoi(optarg); break;
+      case 'o': csv_path = optarg; break;
+      case 'v': verbose = true; break;
+      case ':':
+        cout << usage;
+        exit(1);
+    }
+  }
+  if(sizes.empty()){
+    int s[] = {10,30,100,300,1000};
+    sizes.assign(s,s+5);
+  }
+  if(maps.empty()){
+    maps.push_back("empty");
+    maps.push_back("random");
+    maps.push_back("rooms");
+    if(!cv::imread("sandbox/land.png",cv::IMREAD_GRAYSCALE).empty())
+      maps.push_back("sandbox/land.png");
+    else if(!cv::imread("../sandbox/land.png",cv::IMREAD_GRAYSCALE).empty())
+      maps.push_back("../sandbox/land.png");
+  }
+
+  if(!verbose)
+    Telemetry::instance().open("");//discard the planners' messages
+
+  //the default identity mapping makes world coordinates the pixel coordinates, so that paths can be checked by eye
+  HomographyMapping world;
+  vector<bench_result> results;
+  cout << setw(20) << "map" << setw(7) << "cells" << setw(28) << "planner" << setw(12) << "ms" << setw(9) << "points" << setw(9) << "covered" << endl;
+  for(int mi = 0;mi<maps.size();mi++)
+  for(int si = 0;si<sizes.size();si++){
+    int n = sizes[si];
+    int cs = n <= 100 ? 8 : 2;//cell size in pixels
+    mt19937 rng(seed);
+    cv::Mat gray;
+    if(!mapImage(maps[mi],n,cs,rng,gray)){
+      cout << "can't read map " << maps[mi] << endl;
+      break;
+    }
+    //the map every run starts from
+    vector<vector<nd> > base;
+    PathPlannerGrid mapper(cs,cs,120,base);
+    vector<AprilTags::TagDetection> none;
+    mapper.overlayGrid(none,gray);
+
+    //origin in the first free cell, robots spread over the map and a goal for the shortest path near the end
+    vector<pair<int,int> > taken;
+    vector<AprilTags::TagDetection> dets;
+    int r, c;
+    bool placed = findFreeCell(mapper,0,r,c,taken);
+    dets.push_back(cellDetection(0,r,c,cs));
+    for(int i = 1;placed && i<=n_bots;i++){
+      placed = findFreeCell(mapper,(double)i/(n_bots+2),r,c,taken);
+      dets.push_back(cellDetection(i,r,c,cs));
+    }
+    placed = placed && findFreeCell(mapper,0.97,r,c,taken);
+    dets.push_back(cellDetection(n_bots+1,r,c,cs));
+    if(!placed){
+      cout << "not enough free cells in " << maps[mi] << " at " << n << "x" << n << endl;
+      continue;
+    }
+    int goal_index = dets.size()-1;
+
+    const char *planners[] = {"findshortest","BSACoverage","LocalNeighborPreference","GlobalNeighborPreference","BSACoverageIncremental"};
+    for(int pi = 0;pi<5;pi++){
+      if((pi > 0 && n > coverage_limit) || (pi == 4 && n > incremental_limit)){
+        cout << setw(20) << maps[mi] << setw(7) << n << setw(28) << planners[pi] << setw(12) << "skipped" << endl;
+        continue;
+      }
+      world.detections = dets;
+      vector<vector<nd> > grid = base;
+      bench_result res;
+      res.map = maps[mi], res.planner = planners[pi], res.cells = n;
+      double t0 = tic();
+      if(pi < 4){
+        PathPlannerGrid plan(cs,cs,120,grid);
+        plan.rcells = mapper.rcells, plan.ccells = mapper.ccells;
+        plan.robot_tag_id = 1;
+        plan.robot_id = 1;
+        plan.origin_id = 0;
+        plan.goal_id = goal_index;
+        robot_pose ps;
+        t0 = tic();
+        switch(pi){
+          case 0: plan.findshortest(world); break;
+          case 1: plan.BSACoverage(world,ps); break;
+          case 2: plan.findCoverageLocalNeighborPreference(world,ps); break;
+          case 3: plan.findCoverageGlobalNeighborPreference(world); break;
+        }
+        res.ms = 1000*(tic()-t0);
+        res.path_points = plan.total_points;
+      }
+      else{
+        //every robot jumps to its newest target after each call, as if it had driven there
+        vector<bot_config> bots(n_bots+1,bot_config(cs,cs,120,grid,40.0,2.3,14.5,75,75,128,false));
+        for(int i = 0;i<bots.size();i++){
+          bots[i].id = bots[i].plan.robot_tag_id = bots[i].plan.robot_id = i;
+          bots[i].plan.rcells = mapper.rcells, bots[i].plan.ccells = mapper.ccells;
+          bots[i].plan.origin_id = 0;
+        }
+        vector<char> done(bots.size(),0);
+        int active = n_bots, calls = 0, max_calls = 4*n*n*n_bots;
+        t0 = tic();
+        while(active && calls < max_calls){
+          for(int i = 1;i<bots.size();i++){
+            if(done[i])
+              continue;
+            PathPlannerGrid &plan = bots[i].plan;
+            plan.BSACoverageIncremental(world,bots[i].pose,2.5,bots);
+            calls++;
+            if(!plan.first_call && plan.sk.empty()){//no backtracking point left, the planner must not be called again
+              done[i] = 1;
+              active--;
+              continue;
+            }
+            int last = plan.total_points-1;
+            world.detections[i].cxy = make_pair((float)plan.pixel_path_points[last].first,(float)plan.pixel_path_points[last].second);
+            bots[i].pose.x = plan.path_points[last].x;
+            bots[i].pose.y = plan.path_points[last].y;
+          }
+        }
+        res.ms = 1000*(tic()-t0);
+        res.path_points = 0;
+        for(int i = 1;i<bots.size();i++)
+          res.path_points += bots[i].plan.total_points;
+      }
+      res.covered = coveredCells(grid);
+      results.push_back(res);
+      cout << setw(20) << res.map << setw(7) << res.cells << setw(28) << res.planner << setw(12) << fixed << setprecision(3) << res.ms
+          << setw(9) << res.path_points << setw(9) << res.covered << endl;
+      cout.unsetf(ios::floatfield);
+    }
+  }
+
+  if(!csv_path.empty()){
+    ofstream csv(csv_path.c_str());
+    csv << "map,cells,planner,ms,path_points,covered" << endl;
+    for(int i = 0;i<results.size();i++)
+      csv << results[i].map << "," << results[i].cells << "," << results[i].planner << "," << results[i].ms << ","
+          << results[i].path_points << "," << results[i].covered << endl;
+  }
+  return 0;
+}
@@ -0,0 +1,182 @@
+//feeds SerialReader through a pseudo terminal the way a port delivers bytes, split frames, several frames in one
+//read, frames longer than the maximum and enough traffic to wrap the ring around, and checks that a stop queued on
+//AsyncSerialWriter behind a port that can't keep up is never followed by older velocities, exits with 1 on a failed check
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <mutex>
+#include <chrono>
+#include <thread>
+#include <unistd.h>
+#include <termios.h>
+#include <pty.h>
+#include <poll.h>
+#include "serialreader.h"
+#include "serialwriter.h"
+using namespace std;
+
+static mutex frames_lock;
+static vector<string> frames;
+static int failures = 0;
+
+static void check(bool ok, const string &what){
+  cout << (ok ? "ok    " : "FAIL  ") << what << endl;
+  if(!ok)
+    failures++;
+}
+
+static void send(int fd, const string &s){
+  size_t done = 0;
+  while(done<s.size()){
+    ssize_t n = write(fd,s.data()+done,s.size()-done);
+    if(n<=0)
+      return;
+    done += n;
+  }
+}
+
+//the reader runs on its own thread, give it up to a second to deliver count frames
+static vector<string> waitFrames(int count){
+  for(int i = 0;i<1000;i++){
+    {
+      lock_guard<mutex> lock(frames_lock);
+      if(frames.size() >= count)
+        break;
+    }
+    this_thread::sleep_for(chrono::milliseconds(1));
+  }
+  this_thread::sleep_for(chrono::milliseconds(20));//anything past count is a failure too
+  lock_guard<mutex> lock(frames_lock);
+  vector<string> got;
+  got.swap(frames);
+  return got;
+}
+
+static void sendFrame(AsyncSerialWriter &writer, unsigned char seq, int velocity, bool latest){
+  bot_command c;
+  c.id = 1;
+  c.left = c.right = velocity;
+  unsigned char buf[FRAME_MAX_SIZE];
+  int len = encodeCommandFrame(seq,&c,1,buf);
+  if(latest)
+    writer.sendLatest(buf,len);
+  else
+    writer.send(buf,len);
+}
+
+//sequence numbers of the frames read from fd until it stays quiet for 300 ms
+static void readFrames(int fd, vector<int> *seqs){
+  bot_command cmd;
+  CommandFrameDecoder dec(&cmd,1);
+  unsigned char buf[4096];
+  struct pollfd pfd;
+  pfd.fd = fd;
+  pfd.events = POLLIN;
+  while(poll(&pfd,1,300)>0){
+    ssize_t n = read(fd,buf,sizeof(buf));
+    if(n<=0)
+      break;
+    for(int i = 0;i<n;i++)
+      if(dec.feed(buf[i]))
+        seqs->push_back(dec.seq);
+  }
+}
+
+//the writer thread is held up in write() by a full pty while velocities are published and a stop is queued
+static void checkStopAfterLatest(){
+  int master, slave;
+  char name[256];
+  if(openpty(&master,&slave,name,NULL,NULL) != 0){
+    check(false,"openpty for the writer");
+    return;
+  }
+  struct termios t;
+  tcgetattr(slave,&t);
+  cfmakeraw(&t);
+  tcsetattr(slave,TCSANOW,&t);
+  AsyncSerialWriter writer(256);
+  writer.open(name);
+  const int filler = 200;//frames of 255 commands each, far more than the pty holds
+  vector<bot_command> all(FRAME_MAX_COMMANDS);
+  for(int i = 0;i<all.size();i++){
+    all[i].id = i;
+    all[i].left = all[i].right = 10;
+  }
+  unsigned char buf[FRAME_MAX_SIZE];
+  for(int i = 0;i<filler;i++){
+    int len = encodeCommandFrame(i,all.data(),all.size(),buf);
+    writer.send(buf,len);
+  }
+  this_thread::sleep_for(chrono::milliseconds(100));
+  check(writer.stats().sent<filler,"the writer is held up by the full port");
+  sendFrame(writer,filler,50,true);//velocities
+  sendFrame(writer,filler+1,0,false);//then the stop
+  vector<int> seqs;
+  thread reader(readFrames,master,&seqs);
+  writer.flush();
+  writer.stop();
+  reader.join();
+  check(!seqs.empty() && seqs.back() == filler+1,"the queued stop is the last frame written");
+  check(seqs.size() == filler+1,"the velocities published before the stop are dropped");
+  close(master);
+  close(slave);
+}
+
+int main(){
+  int master, slave;
+  if(openpty(&master,&slave,NULL,NULL,NULL) != 0){
+    cerr << "openpty failed" << endl;
+    return 1;
+  }
+  struct termios t;
+  tcgetattr(slave,&t);
+  cfmakeraw(&t);//the bytes as written, no line editing or echo
+  tcsetattr(slave,TCSANOW,&t);
+
+  const int max_frame = 16;
+  SerialReader reader(64,max_frame);//a small ring so that frames wrap around it
+  reader.start(slave,'\n',[](const unsigned char *data, int len){
+    lock_guard<mutex> lock(frames_lock);
+    frames.push_back(string((const char*)data,len));
+  });
+
+  send(master,"ab");
+  this_thread::sleep_for(chrono::milliseconds(20));
+  send(master,"c");
+  this_thread::sleep_for(chrono::milliseconds(20));
+  send(master,"d\n");
+  vector<string> got = waitFrames(1);
+  check(got.size() == 1 && got[0] == "abcd\n","a frame split over three writes arrives whole");
+
+  send(master,"1\n22\n333\n");
+  got = waitFrames(3);
+  check(got.size() == 3 && got[0] == "1\n" && got[1] == "22\n" && got[2] == "333\n","frames batched in one write arrive one by one");
+
+  send(master,string(20,'x')+"\n");
+  got = waitFrames(2);
+  check(got.size() == 2 && got[0] == string(max_frame,'x') && got[1] == "xxxx\n","a frame over the maximum arrives in pieces");
+  check(reader.overflows() == 1,"the long frame is counted as an overflow");
+
+  vector<string> sent;
+  for(int i = 0;i<50;i++){
+    stringstream s;
+    s << "frame " << i << "\n";
+    sent.push_back(s.str());
+    send(master,s.str());
+    if(i%7 == 0)
+      this_thread::sleep_for(chrono::milliseconds(2));
+  }
+  got = waitFrames(sent.size());
+  check(got == sent,"frames across the end of the ring arrive intact and in order");
+
+  check(reader.framesRead() == 56,"every delivered piece is counted");
+  reader.stop();
+  close(master);
+  close(slave);
+
+  checkStopAfterLatest();
+  if(failures)
+    cout << failures << " checks failed" << endl;
+  return failures ? 1 : 0;
+}
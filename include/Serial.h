@@ -20,6 +20,9 @@ public:
   // open a serial port connection
   void open(const std::string& port, int rate = 9600);
 
+  // file descriptor of the port, -1 if not open
+  int fd() const { return m_serialPort; }
+
   // read a single character
   int read() const;
 
@@ -29,6 +32,8 @@ public:
   // send a string
   void print(std::string str) const;
   void print(unsigned char a) const;
+  // send a block of bytes with a single write call
+  void write(const unsigned char* buf, int len) const;
 
   // send an integer
   void print(int num) const;
@@ -0,0 +1,43 @@
+#ifndef ANCHORS_H
+#define ANCHORS_H
+#include <vector>
+#include <utility>
+#include <Eigen/Dense>
+#include "AprilTags/TagDetection.h"
+
+//ground plane as seen from the camera, origin and unit axes in camera coordinates
+struct anchor_plane{
+  Eigen::Vector3d origin;
+  Eigen::Vector3d x_axis;
+  Eigen::Vector3d y_axis;
+};
+
+//tags known not to move(the origin tag), whose plane is averaged over their first lock_frames sightings and
+//then locked, so that neither the pose solve nor its jitter is paid on every frame, a locked anchor is solved
+//again only once one of its corners has moved more than drift pixels from where it was locked(camera bumped)
+class AnchorRegistry{
+  public:
+    int lock_frames;//sightings averaged into the locked plane
+    double drift;//pixels
+    AnchorRegistry():lock_frames(30),drift(2){}
+    void addStatic(int id);
+    bool isStatic(int id) const;
+    bool locked(int id) const;
+    //the plane of the tag through a pose solve of the detection
+    static void solve(const AprilTags::TagDetection &det, double tag_size, double fx, double fy, double px, double py, anchor_plane &plane);
+    //the plane of the static tag det.id, the locked one if it is still valid, else solved and averaged into
+    //the estimate being built, returns false if plane is the same locked plane returned before
+    bool plane(const AprilTags::TagDetection &det, double tag_size, double fx, double fy, double px, double py, anchor_plane &plane);
+  private:
+    struct anchor{
+      bool is_static;
+      bool locked;
+      int seen;//sightings in the running average
+      anchor_plane sum;//of the sightings, the locked plane once locked
+      std::pair<float,float> corners[4];//mean corners of the sightings
+      anchor():is_static(false),locked(false),seen(0){}
+      void restart(){ locked = false, seen = 0; }
+    };
+    std::vector<anchor> m_anchors;//indexed by tag id
+};
+#endif
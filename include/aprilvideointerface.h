@@ -18,6 +18,13 @@
 #include "AprilTags/Tag36h11.h"
 
 #include "structures.h"
+#include "v4l2capture.h"
+#include "sessionlog.h"
+#include "profiling.h"
+#include "worldmapping.h"
+#include "telemetry.h"
+#include "framebus.h"
+#include "anchors.h"
 double tic();
 //Normalize angle to be within the interval [-pi,pi].
 inline double standardRad(double t);
@@ -27,13 +34,18 @@ void wRo_to_euler(const Eigen::Matrix3d& wRo, double& yaw, double& pitch, double
 std::string type2str(int type);
 
 //starts video capture and detects the april tags in the scene, also parses the command line options
-class AprilInterfaceAndVideoCapture{
+class AprilInterfaceAndVideoCapture : public WorldMapping{
   public:
   AprilTags::TagDetector* m_tagDetector;
   AprilTags::TagCodes m_tagCodes;
   bool m_draw; // draw image and April tag detections?
+  int m_drawEvery; // frames between two drawn ones, the overlay is kept up to date on these only
   bool m_arduino; // send tag detections to serial port?
-  bool m_timing; // print timing information for each tag extraction call
+  bool m_timing; // profile the stages of tag extraction, summary printed every m_profileEvery frames
+  int m_profileEvery;
+  std::string m_profilePath; // where to export the detector profile on exit(csv or json)
+  DetectorProfiler m_profiler;
+  bool m_latestOnly; // drain the camera in the background and only process the newest frame
 
   int m_width; // image size in pixels
   int m_height;
@@ -47,6 +59,25 @@ class AprilInterfaceAndVideoCapture{
   std::list<std::string> m_imgNames;
 
   cv::VideoCapture m_cap;
+  std::string m_v4l2Path; // capture straight from this V4L2 device(or raw YUYV file) instead of m_cap
+  int m_v4l2Buffers; // number of mmap'd driver buffers
+  V4L2Capture m_v4l2;
+  std::string m_recordPath; // session log to record to
+  bool m_compressRecord; // store the recorded frames as png
+  std::string m_replayPath; // session log to replay frames from instead of a camera
+  SessionReader m_replay;
+  std::string m_logPath; // log messages and metrics go here instead of stdout
+  std::string m_latencyPath; // where to export the latency histograms on exit
+  int m_predictEvery; // frames between full detections when tracking the robots with a pose filter, 0 to always detect
+  double m_velocityScale; // world units per second of one wheel velocity unit, 0 if unknown
+  double m_controlRate; // rate in Hz of a control loop of its own, 0 to step the controllers once per frame
+  double m_commandLatency; // seconds from computing a command to the robot acting on it
+  std::string m_busName; // shared memory bus to publish the frames on, none if empty
+  int m_planThreads; // threads planning the robots' paths, 0 for one per core
+  int m_lookahead; // spiral points planned ahead of every robot
+  int m_maxRobots; // most robots registered at once, a tag seen while all are taken is ignored
+  int m_anchorFrames; // frames the plane of the static tags is averaged over before it is locked, 0 to solve it every frame
+  AnchorRegistry m_anchors;
 
   int m_exposure;
   int m_gain;
@@ -56,7 +87,6 @@ class AprilInterfaceAndVideoCapture{
   Eigen::Vector3d x_axis;
   Eigen::Vector3d y_axis;
   
-  std::vector<AprilTags::TagDetection> detections;
   //remember to add a class var to specify video device number, currently being assumed at 0 in setupvideo
   AprilInterfaceAndVideoCapture() :
     // default settings, most can be modified through command line options (see below)
@@ -64,8 +94,19 @@ class AprilInterfaceAndVideoCapture{
     m_tagCodes(AprilTags::tagCodes36h11),
 
     m_draw(true),
+    m_drawEvery(1),
     m_arduino(false),
     m_timing(false),
+    m_profileEvery(100),
+    m_latestOnly(false),
+    m_predictEvery(0),
+    m_velocityScale(0),
+    m_controlRate(0),
+    m_commandLatency(0),
+    m_planThreads(1),
+    m_lookahead(1),
+    m_maxRobots(32),
+    m_anchorFrames(0),
 
     //below parameters are the most important
     //use a camera calibration technique to find out the below parameters
@@ -81,7 +122,9 @@ class AprilInterfaceAndVideoCapture{
     m_exposure(-1),
     m_gain(-1),
     m_brightness(-1), 
-    m_deviceId(0){}
+    m_deviceId(0),
+    m_v4l2Buffers(4),
+    m_compressRecord(false){}
 
   // changing the tag family
   void setTagCodes(string s);
@@ -90,13 +133,26 @@ class AprilInterfaceAndVideoCapture{
   void setup();
   void setupVideo();
 
+  //intersects the ray through the pixel with the plane set by extractPlane
   void pixelToWorld(double x,double y,double &xd,double &yd);
   //find the normal vector to the plane formed by the endpoints of tag
   void findNormal(Eigen::Vector3d &trans, Eigen::Matrix3d &rot, Eigen::Vector3d &result);
-  void extractPlane(int ind);
+  //takes the plane from the tag, through m_anchors if it is a static tag, false if the plane did not change
+  bool extractPlane(int ind);
   //robot is assumed to be facing positive y direction of it's apriltag
   void findRobotPose(int ind, robot_pose &rob);
+  //reads the next frame, the V4L2 backend only fills image_gray and leaves image empty
+  //t_capture is when the frame was captured
+  bool grabFrame(cv::Mat& image, cv::Mat& image_gray, double &t_capture);
   void processImage(cv::Mat& image, cv::Mat& image_gray);
+  //same as processImage but stores the tags in dets instead of the class variable, so that it can run
+  //in a separate thread from the code reading detections, if image is empty image_gray is used as is
+  void detectTags(cv::Mat& image, cv::Mat& image_gray, std::vector<AprilTags::TagDetection> &dets);
+  //detects only inside the given rectangles of the image, the detections are in full image coordinates
+  //the windowed runs are left out of the detector profile
+  void detectTagsInWindows(cv::Mat& image, cv::Mat& image_gray, const std::vector<cv::Rect> &windows, std::vector<AprilTags::TagDetection> &dets);
+  // export the detector profile if asked for
+  void writeProfile();
   // Load and process a single image
   void loadImages();
   // check the image container to find if video is to be processed or image
@@ -0,0 +1,142 @@
+#ifndef COMMANDFRAME_H
+#define COMMANDFRAME_H
+//framed binary protocol carrying the wheel velocities of all robots in a single broadcast frame
+//the header has no dependencies and is fully inline so that the same decoder can be used
+//from the arduino sketch(copy this file to the sketch folder) and from host side code
+//
+//frame layout:
+//  byte 0          FRAME_START
+//  byte 1          number of commands n(0 to FRAME_MAX_COMMANDS)
+//  byte 2          sequence number, wraps around
+//  byte 3          crc8 over bytes 1 and 2
+//  3*n bytes       id, 128+left velocity, 128+right velocity for every robot
+//  last byte       crc8 over bytes 1 to 3*n+3
+//the start byte is not escaped, the header crc makes the decoder drop a false start found in the
+//payload right away instead of swallowing the following frames while resynchronizing
+#define FRAME_START 0x7E
+#define FRAME_OVERHEAD 5
+#define FRAME_MAX_COMMANDS 255
+#define FRAME_MAX_ID 255//ids go out as one byte
+#define FRAME_MAX_SIZE (FRAME_OVERHEAD+3*FRAME_MAX_COMMANDS)
+
+struct bot_command{
+  int id;
+  int left, right;//wheel velocities, clamped to [-128,127] on the wire
+};
+
+//crc-8 with polynomial x^8+x^2+x+1, computed bitwise to avoid a table in the robot's memory
+inline unsigned char crc8Update(unsigned char crc, unsigned char data){
+  crc ^= data;
+  for(int i = 0;i<8;i++)
+    crc = (crc & 0x80) ? (unsigned char)((crc<<1)^0x07) : (unsigned char)(crc<<1);
+  return crc;
+}
+
+inline unsigned char velocityToByte(int v){
+  if(v<-128) v = -128;
+  if(v>127) v = 127;
+  return (unsigned char)(128+v);
+}
+
+//writes the frame for n commands into out, which must hold FRAME_OVERHEAD+3*n bytes, returns the frame size
+//or -1 if too many commands are given
+inline int encodeCommandFrame(unsigned char seq, const bot_command *cmds, int n, unsigned char *out){
+  if(n<0 || n>FRAME_MAX_COMMANDS)
+    return -1;
+  int len = 0;
+  out[len++] = FRAME_START;
+  out[len++] = (unsigned char)n;
+  out[len++] = seq;
+  out[len++] = crc8Update(crc8Update(0,out[1]),out[2]);
+  for(int i = 0;i<n;i++){
+    out[len++] = (unsigned char)cmds[i].id;
+    out[len++] = velocityToByte(cmds[i].left);
+    out[len++] = velocityToByte(cmds[i].right);
+  }
+  unsigned char crc = 0;
+  for(int i = 1;i<len;i++)
+    crc = crc8Update(crc,out[i]);
+  out[len++] = crc;
+  return len;
+}
+
+//incremental decoder, feed it one received byte at a time
+//commands are collected in the buffer given by the user, when filter_id is not negative only the command
+//for that robot is kept so a robot needs a buffer of a single command
+class CommandFrameDecoder{
+  public:
+    bot_command *commands;
+    int capacity;
+    int filter_id;
+    int count;//commands stored from the last complete frame
+    unsigned char seq;//sequence number of the last complete frame
+    unsigned long crc_errors;
+    CommandFrameDecoder(bot_command *buf, int cap, int fid = -1):commands(buf),capacity(cap),filter_id(fid),count(0),seq(0),crc_errors(0),state(WAIT_START){}
+    //returns 1 when a frame with a valid crc has just been completed, count and commands are valid only until the next byte is fed
+    int feed(unsigned char b){
+      switch(state){
+        case WAIT_START:
+          if(b == FRAME_START){
+            crc = 0;
+            state = READ_COUNT;
+          }
+          return 0;
+        case READ_COUNT:
+          crc = crc8Update(crc,b);
+          expected = b;
+          state = READ_SEQ;
+          return 0;
+        case READ_SEQ:
+          crc = crc8Update(crc,b);
+          pending_seq = b;
+          state = READ_HEADER_CRC;
+          return 0;
+        case READ_HEADER_CRC:
+          if(b != crc){//false start, look for the next start byte
+            crc_errors++;
+            state = (b == FRAME_START) ? READ_COUNT : WAIT_START;
+            crc = 0;
+            return 0;
+          }
+          crc = crc8Update(crc,b);
+          stored = 0;
+          field = 0;
+          received = 0;
+          state = expected ? READ_PAYLOAD : READ_CRC;
+          return 0;
+        case READ_PAYLOAD:
+          crc = crc8Update(crc,b);
+          current[field++] = b;
+          if(field == 3){
+            field = 0;
+            received++;
+            if((filter_id < 0 || current[0] == filter_id) && stored < capacity){
+              commands[stored].id = current[0];
+              commands[stored].left = (int)current[1]-128;
+              commands[stored].right = (int)current[2]-128;
+              stored++;
+            }
+            if(received == expected)
+              state = READ_CRC;
+          }
+          return 0;
+        case READ_CRC:
+          state = WAIT_START;
+          if(b != crc){
+            crc_errors++;
+            return 0;
+          }
+          count = stored;
+          seq = pending_seq;
+          return 1;
+      }
+      return 0;
+    }
+  private:
+    enum {WAIT_START, READ_COUNT, READ_SEQ, READ_HEADER_CRC, READ_PAYLOAD, READ_CRC} state;
+    unsigned char crc;
+    unsigned char current[3];
+    unsigned char pending_seq;
+    int expected, received, stored, field;
+};
+#endif
@@ -2,8 +2,33 @@
 #define CONTROLLER_H
 #include <utility>
 #include <vector>
+#include <deque>
 #include "structures.h"
 
+//structure of arrays used to step the controller for the whole fleet in one call
+//x,y,omega hold the robot poses and tx,ty the next path point chosen for every robot
+//robots with active set to 0 (path finished or not in view) are given zero velocities
+struct fleet_stimuli{
+  std::vector<double> x,y,omega;
+  std::vector<double> tx,ty;
+  std::vector<char> active;
+  std::vector<double> rel_x,rel_y,dist_sq;//scratch, target in robot relative coordinates
+  std::vector<int> left,right;//output wheel velocities
+  void resize(int n);
+  int size() const{ return x.size(); }
+};
+
+//moves a differential drive robot for dt seconds with the given wheel velocities, velocity_scale converts
+//the wheel velocity units sent to the robots into world units per second, the robot follows the exact arc
+void integrateUnicycle(robot_pose &rp, int left, int right, double axle_length, double velocity_scale, double dt);
+
+//wheel velocities sent to a robot and when they were computed
+struct timed_command{
+  double t;
+  int left, right;
+  timed_command(double a,int b,int c):t(a),left(b),right(c){}
+};
+
 class PurePursuitController{
   public:
     double look_ahead_distance;
@@ -16,6 +41,11 @@ class PurePursuitController{
     double min_turn_radius;
     bool next_point_by_pursuit;
     int next_index;//used exclusively by the findNextPointByPathIndex function, don't use it for any other purpose
+    //latency compensation, off while velocity_scale is 0: a pose taken at t_pose is moved forward to the time
+    //the next command takes effect by integrating the commands issued since, see predictPose
+    double latency = 0;//seconds from computing a command to the robot acting on it(transmit and motor response)
+    double velocity_scale = 0;//world units per second of one wheel velocity unit
+    std::deque<timed_command> issued;//commands sent to this robot, oldest first
     //finds turn radius in axle length scale
     void calculateMinimumTurnRadius();
     PurePursuitController(double a,double b,double c, int d,int e,int f,bool g):look_ahead_distance(a),reach_radius(b),axle_length(c),linear_velocity(d),inplace_turn_velocity(e),max_velocity(f),next_point_by_pursuit(g){
@@ -28,6 +58,21 @@ class PurePursuitController{
     double distance(double x1,double y1,double x2,double y2);
     int findNextPointByPursuit(robot_pose &rp,std::vector<pt> &path);
     int findNextPointByPathIndex(robot_pose &rp, std::vector<pt> &path);
+    //selects the next target point using whichever strategy was configured, returns path size if the path is finished
+    int findNextPoint(robot_pose &rp, std::vector<pt> &path);
+    //wheel velocities given the target in robot relative coordinates(robot facing positive y) and its squared distance
+    std::pair<int,int> stimuliFromRelative(double rel_x, double rel_y, double dist_sq);
     std::pair<int,int> computeStimuli(robot_pose &rp,std::vector<pt> &path);
+    //same for a pose taken at t_pose, compensated for its age and the command latency, t_now is the current time
+    std::pair<int,int> computeStimuli(robot_pose &rp,std::vector<pt> &path, double t_pose, double t_now);
+    //where the robot will be when a command computed at t_now takes effect, given its pose at t_pose and the
+    //commands issued before, each acting latency seconds after it was issued
+    robot_pose predictPose(const robot_pose &rp, double t_pose, double t_now);
+    //remembers a command sent at t for predictPose, the ones too old to matter are dropped
+    void recordCommand(int left, int right, double t);
+    //forgets the commands issued and the progress along the path, for a slot taken over by another robot
+    void reset();
+    //computes the wheel velocities of every robot in fs using the parameters of this controller
+    void computeFleetStimuli(fleet_stimuli &fs);
 };
 #endif
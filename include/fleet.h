@@ -0,0 +1,67 @@
+#ifndef FLEET_H
+#define FLEET_H
+#include <vector>
+#include "pathplanners.h"
+#include "commandframe.h"
+#include "workerpool.h"
+
+//the robots in play, found by tag id through an open addressing hash instead of using the tag id as an index,
+//so that the tags can be any ids up to FRAME_MAX_ID(the command frame has one byte for it) and robots can join and
+//leave during a run
+//the state of the robots is kept by slot in contiguous vectors of a fixed size, a slot never moves while its
+//robot is registered(other threads may keep using it) and a retired slot goes on a free list for the next robot
+class FleetRegistry{
+  public:
+    std::vector<bot_config> bots;//by slot, bots[s].id is the tag id, -1 for a free slot
+    std::vector<double> last_seen;//by slot, time the robot was last seen
+    std::vector<char> pinned;//by slot, never retired(the origin)
+    //by slot, changes whenever the slot is handed to a robot or freed, whoever steps the controllers compares it
+    //with the one it last stepped and stops the robot that left and clears the controller when it differs
+    std::vector<unsigned> generation;
+    std::vector<char> known;//by tag id, every robot registered so far, all of them are stopped at shutdown
+    double retire_after;//seconds a robot may go unseen before retireStale drops it
+    //capacity is the number of slots, every robot starts as a copy of proto
+    FleetRegistry(int capacity, const bot_config &proto);
+    //slot of the tag, -1 if it is not registered
+    int slot(int tag_id) const;
+    //slot of the tag, registered in a free slot if it is new(the most recently freed one, slots are handed
+    //out in order at first), -1 if every slot is taken or the id can't be sent commands, marks the robot seen at time t
+    int add(int tag_id, double t, bool pin = false);
+    //frees the slot, its planner and pose start over, its controller is left alone for the thread stepping it
+    void retire(int s);
+    //retires every robot not pinned and not seen since t-retire_after, returns how many
+    int retireStale(double t);
+    int count() const{ return m_count; }
+    int capacity() const{ return bots.size(); }
+  private:
+    int bucket(int tag_id) const;//bucket of the tag or the empty bucket ending its probe sequence
+    void rehash();
+    std::vector<int> m_keys;//tag id by bucket, or one of the markers below
+    std::vector<int> m_slots;//slot by bucket
+    std::vector<int> m_free;//free slots, taken from the back
+    int m_count;//registered robots
+    int m_used;//buckets holding a tag or a tombstone
+    bot_config m_proto;
+    enum{ EMPTY = -1, TOMBSTONE = -2 };
+};
+
+//takes the incremental bsa step of every robot in view together on several threads, in rounds: every robot still
+//planning proposes its next cell from the same state of the map and bids for it, the lowest tag id bidding for a
+//cell gets it and commits, the others(and winners short of their lookahead) propose again in the next round, so the
+//paths do not depend on how the threads happen to run, the first step of a robot and the return phase(which looks at
+//every robot) run one robot at a time after the rounds, the return phase spreading its searches over the threads,
+//which are started on the first call and kept for the next ones
+class FleetPlanner{
+  public:
+    int threads;//1 plans the robots one after the other, 0 takes one thread per core
+    FleetPlanner(int n = 1):threads(n){}
+    //plans bots[1...] that are in view, bots[0] holds the shared map
+    void plan(std::vector<bot_config> &bots, WorldMapping &testbed, double reach_distance);
+  private:
+    GridClaims m_claims;
+    WorkerPool m_workers;
+    std::vector<bsa_move> m_moves;//by slot
+    std::vector<int> m_pending, m_next;//slots still planning in this round and the next
+    std::vector<char> m_won;//by slot
+};
+#endif
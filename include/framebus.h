@@ -0,0 +1,88 @@
+#ifndef FRAMEBUS_H
+#define FRAMEBUS_H
+#include <atomic>
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include "opencv2/opencv.hpp"
+#include "AprilTags/TagDetection.h"
+#include "sessionlog.h"
+
+//POSIX shared memory ring through which the process running the camera publishes every frame with its
+//detections and robot poses, any number of other processes(a viewer, a logger, a planner) attach to it
+//read only and never slow the publisher down
+//
+//segment layout: a framebus_header, then FRAMEBUS slots of slot_bytes each, a framebus_slot followed by
+//the gray pixels of the frame, each slot is guarded by a sequence lock: the writer makes the sequence odd,
+//fills the slot and makes it even again, a reader uses the slot in place and then checks that the sequence
+//has not moved, if it has the writer wrapped around onto the slot meanwhile and what was read is discarded
+#define FRAMEBUS_MAGIC 0x31425344u //"DSB1"
+#define FRAMEBUS_DEFAULT_NAME "/differentialDrive"
+const int FRAMEBUS_MAX_TAGS = 64;
+
+struct framebus_header{
+  uint32_t magic;
+  uint32_t slots;
+  uint32_t width, height;//largest frame a slot holds
+  uint64_t slot_bytes;
+  std::atomic<uint64_t> published;//frames published so far, the newest is in slot (published-1)%slots
+};
+
+struct framebus_slot{
+  std::atomic<uint64_t> seq;//odd while the writer fills the slot
+  int64_t frame_id;
+  double t_capture;
+  int32_t rows, cols;
+  uint32_t n_detections, n_poses;
+  session_detection detections[FRAMEBUS_MAX_TAGS];
+  session_pose poses[FRAMEBUS_MAX_TAGS];
+  const unsigned char* pixels() const{ return (const unsigned char*)(this+1); }
+  unsigned char* pixels(){ return (unsigned char*)(this+1); }
+};
+
+class FrameBusWriter{
+  public:
+    FrameBusWriter();
+    ~FrameBusWriter();
+    //creates the bus, replacing a stale one of the same name, for frames up to width x height
+    bool open(const std::string &name, int width, int height, int slots = 4);
+    //removes the name, readers still attached keep their mapping
+    void close();
+    bool isOpened() const{ return m_header != NULL; }
+    //frames larger than the bus are published without pixels, tags beyond FRAMEBUS_MAX_TAGS are left out
+    void publish(long frame_id, double t_capture, const cv::Mat &gray,
+        const std::vector<AprilTags::TagDetection> &dets, const std::vector<session_pose> &poses);
+  private:
+    framebus_header *m_header;
+    size_t m_size;
+    std::string m_name;
+};
+
+//a published frame seen in place, nothing is copied, so whatever is read through it only counts if
+//FrameBusReader::valid still holds afterwards
+struct framebus_view{
+  const framebus_slot *slot;
+  uint64_t seq;
+  cv::Mat gray;//wraps the pixels in the shared segment, read only
+};
+
+class FrameBusReader{
+  public:
+    FrameBusReader();
+    ~FrameBusReader();
+    bool open(const std::string &name);
+    void close();
+    bool isOpened() const{ return m_header != NULL; }
+    uint64_t published() const{ return m_header ? m_header->published.load(std::memory_order_acquire) : 0; }
+    //the newest frame, false if nothing has been published or the writer is refilling its slot
+    bool latest(framebus_view &view);
+    //true if the slot has not been reused since the view was taken
+    bool valid(const framebus_view &view) const;
+    //copies out of a view, check valid after them
+    static void detections(const framebus_view &view, std::vector<AprilTags::TagDetection> &dets);
+    static void poses(const framebus_view &view, std::vector<session_pose> &poses);
+  private:
+    const framebus_header *m_header;
+    size_t m_size;
+};
+#endif
@@ -0,0 +1,40 @@
+#ifndef FRAMEGRABBER_H
+#define FRAMEGRABBER_H
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include "aprilvideointerface.h"
+#include "lockfree.h"
+
+struct grabbed_frame{
+  long frame_id;//counts every frame read from the device, including skipped ones
+  double t_capture;
+  cv::Mat image;
+  cv::Mat image_gray;
+};
+
+//keeps reading the camera from its own thread so that the driver never queues up old frames, only the newest
+//frame is kept and handed out, frames replaced before anyone took them are counted as skipped
+class LatestFrameGrabber{
+  public:
+    LatestFrameGrabber();
+    ~LatestFrameGrabber();
+    //the capture must already be set up, only the grabber thread reads from it until stop()
+    void start(AprilInterfaceAndVideoCapture &camera);
+    void stop();
+    //waits until a frame newer than the last one taken is available, returns false once stopped
+    bool latest(grabbed_frame &frame);
+    unsigned long skipped() const{ return m_skipped; }
+    unsigned long grabbed() const{ return m_grabbed; }
+  private:
+    void run();
+    AprilInterfaceAndVideoCapture *m_camera;
+    TripleBuffer<grabbed_frame> m_slot;
+    std::thread m_thread;
+    std::mutex m_mutex;//only used to sleep on the condition variable
+    std::condition_variable m_cond;
+    std::atomic<bool> m_running;
+    std::atomic<unsigned long> m_skipped, m_grabbed;
+};
+#endif
@@ -0,0 +1,80 @@
+#ifndef LOCKFREE_H
+#define LOCKFREE_H
+#include <atomic>
+#include <vector>
+#include <cstddef>
+
+//bounded single producer single consumer queue, push and pop never block or allocate
+//exactly one thread may push and exactly one(other) thread may pop
+template <class T>
+class SpscQueue{
+  public:
+    SpscQueue(int capacity):buf(capacity+1),head(0),tail(0){}//one slot is kept empty to tell full from empty
+    //returns false if the queue is full, the item is then not added
+    bool push(const T &item){
+      size_t t = tail.load(std::memory_order_relaxed);
+      size_t nt = next(t);
+      if(nt == head.load(std::memory_order_acquire))
+        return false;
+      buf[t] = item;
+      tail.store(nt,std::memory_order_release);
+      return true;
+    }
+    //returns false if the queue is empty
+    bool pop(T &item){
+      size_t h = head.load(std::memory_order_relaxed);
+      if(h == tail.load(std::memory_order_acquire))
+        return false;
+      item = buf[h];
+      head.store(next(h),std::memory_order_release);
+      return true;
+    }
+    //approximate when called while the other side is active
+    int size() const{
+      size_t h = head.load(std::memory_order_acquire), t = tail.load(std::memory_order_acquire);
+      return t>=h ? t-h : t+buf.size()-h;
+    }
+    int capacity() const{ return buf.size()-1; }
+    bool empty() const{ return size() == 0; }
+  private:
+    size_t next(size_t i) const{ return i+1 == buf.size() ? 0 : i+1; }
+    std::vector<T> buf;
+    std::atomic<size_t> head;//next slot to pop, written by consumer
+    std::atomic<size_t> tail;//next slot to push, written by producer
+};
+
+//triple buffer holding the latest value written by one producer for one consumer
+//the producer never waits for the consumer, values that are overwritten before being read are simply lost
+template <class T>
+class TripleBuffer{
+  public:
+    TripleBuffer():buf(3),state(1){
+      write_index = 0;
+      read_index = 2;
+    }
+    //producer side, fill the value returned and then publish it
+    T& writeBuffer(){ return buf[write_index]; }
+    //returns true if the previously published value had not been read yet(it is now discarded)
+    bool publish(){
+      int old = state.exchange(write_index | DIRTY,std::memory_order_acq_rel);
+      write_index = old & INDEX;
+      return (old & DIRTY) != 0;
+    }
+    //consumer side, returns true if a new value was published since the last update
+    bool update(){
+      if(!(state.load(std::memory_order_acquire) & DIRTY))
+        return false;
+      int old = state.exchange(read_index,std::memory_order_acq_rel);
+      read_index = old & INDEX;
+      return true;
+    }
+    T& readBuffer(){ return buf[read_index]; }
+    bool pending() const{ return (state.load(std::memory_order_acquire) & DIRTY) != 0; }
+  private:
+    enum {INDEX = 3, DIRTY = 4};
+    std::vector<T> buf;
+    std::atomic<int> state;//index of the middle buffer, DIRTY is set when it holds an unread value
+    int write_index;//owned by the producer
+    int read_index;//owned by the consumer
+};
+#endif
@@ -0,0 +1,30 @@
+#ifndef OVERLAY_H
+#define OVERLAY_H
+#include <vector>
+#include "opencv2/opencv.hpp"
+#include "pathplanners.h"
+
+//keeps the grid and the paths drawn on a layer of their own, so that a frame only costs a masked copy
+//of the layer instead of redrawing everything: the grid is drawn once, and of every path only the
+//segments added since the last update
+class OverlayCompositor{
+  public:
+    OverlayCompositor():m_gray_stale(true),m_rcells(-1),m_ccells(-1){}
+    //brings the layer up to date for frames of rows x cols, the grid is taken from grid and the paths
+    //from bots[1...], a path that got shorter(replanned from scratch) makes the whole layer redrawn
+    void update(PathPlannerGrid &grid, std::vector<bot_config> &bots, int rows, int cols);
+    //draws the layer over image, which must be the size given to update and 8 bit, gray or color
+    void compose(cv::Mat &image);
+    //forgets the layer, the next update draws it anew(e.g. after the grid cells were changed)
+    void invalidate();
+  private:
+    void drawGrid(PathPlannerGrid &grid);
+    void drawSegments(PathPlannerGrid &plan, int from);
+    cv::Mat m_layer;//color of the overlay
+    cv::Mat m_mask;//nonzero where the overlay covers the frame
+    cv::Mat m_gray;//m_layer converted once for gray frames
+    bool m_gray_stale;
+    std::vector<int> m_drawn;//path points already on the layer, per bot
+    int m_rcells, m_ccells;
+};
+#endif
@@ -1,16 +1,61 @@
 #ifndef PLANNER_H
 #define PLANNER_H
-#include "aprilvideointerface.h"
+#include "opencv2/opencv.hpp"
+#include "worldmapping.h"
+#include "telemetry.h"
 #include "controllers.h"
 #include <vector>
 #include <utility>
 #include <stack>
 #include <cstring>
+#include <atomic>
+#include <memory>
 //the cell empty criteria is an adjustable parameter as well
 #define INACTIVE 0
 #define SPIRAL 1
 #define RETURN 2
 struct bot_config;
+class WorkerPool;
+
+//owner of every cell of a shared world_grid as atomics, so that planners running in parallel take cells with
+//a compare and swap and only then write the steps and r_id of the cell, which no other planner touches after
+//that, planners holding claims check blocked cells here instead of reading steps, which may be being written
+class GridClaims{
+  public:
+    enum{ FREE = -1, TAKEN = -2 };//TAKEN: visited, by no robot in particular
+    GridClaims():m_rcells(0),m_ccells(0){}
+    //takes the owners from steps and r_id, not thread safe
+    void reset(const std::vector<std::vector<nd> > &grid, int rcells, int ccells);
+    int rows() const{ return m_rcells; }
+    int cols() const{ return m_ccells; }
+    int owner(int r,int c) const{ return m_owner[r*m_ccells+c].load(std::memory_order_acquire); }
+    //true if the cell was free and now belongs to id
+    bool claim(int r,int c,int id){
+      int expected = FREE;
+      return m_owner[r*m_ccells+c].compare_exchange_strong(expected,id,std::memory_order_acq_rel);
+    }
+    //gives the cell to id whoever held it, for planners running alone
+    void set(int r,int c,int id){ m_owner[r*m_ccells+c].store(id,std::memory_order_release); }
+    //bids of a round of parallel planning, the lowest id bidding for a cell wins it, whatever the timing
+    void bid(int r,int c,int id);
+    int winner(int r,int c) const{ return m_bid[r*m_ccells+c].load(std::memory_order_acquire); }
+    void clearBid(int r,int c){ m_bid[r*m_ccells+c].store(NO_BID,std::memory_order_relaxed); }
+  private:
+    enum{ NO_BID = 0x7fffffff };
+    std::unique_ptr<std::atomic<int>[]> m_owner, m_bid;
+    int m_rcells, m_ccells;
+};
+
+//what one incremental bsa step of a robot comes to, found without changing the shared map
+enum{ BSA_IDLE, BSA_CLAIM, BSA_FIRST, BSA_BACKTRACK };
+struct bsa_move{
+  int kind;
+  std::pair<int,int> cell;//the next spiral cell, BSA_CLAIM and BSA_FIRST
+  std::pair<int,int> from;//the stack top it is reached from
+  int wall_reference;//of the new cell
+  bsa_move():kind(BSA_IDLE),wall_reference(-1){}
+};
+
 class PathPlannerGrid{
   public:
     //the ids below are the indexes in the detections vector, not the actual tag ids
@@ -26,7 +71,7 @@ class PathPlannerGrid{
     int cell_size_y;
     int threshold_value;
     std::vector<pt> path_points;
-    std::vector<pair<int,int> > pixel_path_points;
+    std::vector<std::pair<int,int> > pixel_path_points;
     int total_points;
     int start_grid_x,start_grid_y;
     int goal_grid_x, goal_grid_y;
@@ -35,24 +80,41 @@ class PathPlannerGrid{
     std::vector<std::vector<nd> > &world_grid;//grid size is assumed to be manueveurable by the robot
     //the following matrix is used to encode local preference based on current place and parent place, one is added to avoid negative array index
     std::pair<int,int> aj[3][3][4];
-    stack<pair<int,int> > sk;//stack is needed to remember all the previous points visited and backtrack, should be unique for every instance, used primarily by the incremental bsa
+    std::stack<std::pair<int,int> > sk;//stack is needed to remember all the previous points visited and backtrack, should be unique for every instance, used primarily by the incremental bsa
     
     //below two are used exclusively for incrementalbsa function, don't use for any other purpose
     int first_call;
-    vector<bt> bt_destinations;
+    std::vector<bt> bt_destinations;
     int phase;
+    //cells given up while looking for a spiral point, from the proposing step to the backtracking one
+    std::vector<std::pair<int,int> > incumbent_cells;
+    int ic_no;
+    GridClaims *claims;//set when planners share the map concurrently, blocked cells are then looked up there
+    WorkerPool *workers;//set when the return phase may spread its searches over threads
+    //spiral points planned ahead of the robot assuming it gets to its target, with 1 the next one is planned only once
+    //the robot reached the last, more keep the controller from stopping at every cell until the next frame
+    int lookahead;
 
     PathPlannerGrid(int csx,int csy,int th,std::vector<std::vector<nd> > &wg):cell_size_x(csx),cell_size_y(csy),threshold_value(th),total_points(0),start_grid_x(-1),start_grid_y(-1),goal_grid_x(-1),goal_grid_y(-1),robot_id(-1),goal_id(-1),origin_id(-1),world_grid(wg){
       initializeLocalPreferenceMatrix();
       path_color = cv::Scalar(rng.uniform(0,255),rng.uniform(0,255),rng.uniform(0,255));
       first_call = 1;
       phase = INACTIVE;
+      ic_no = 0;
+      claims = NULL;
+      workers = NULL;
+      lookahead = 1;
     }
+    //for temporary maps, which are never drawn and may be made on several threads at once, so rng is left alone
     PathPlannerGrid(std::vector<std::vector<nd> > &wg):total_points(0),start_grid_x(-1),start_grid_y(-1),goal_grid_x(-1),goal_grid_y(-1),robot_id(-1),goal_id(-1),origin_id(-1),world_grid(wg){
       initializeLocalPreferenceMatrix();
-      path_color = cv::Scalar(rng.uniform(0,255),rng.uniform(0,255),rng.uniform(0,255));
+      path_color = cv::Scalar(0,0,0);
       first_call = 1;
       phase = INACTIVE;
+      ic_no = 0;
+      claims = NULL;
+      workers = NULL;
+      lookahead = 1;
     }
     PathPlannerGrid& operator=(const PathPlannerGrid& pt){
       path_color = pt.path_color;
@@ -75,6 +137,10 @@ class PathPlannerGrid{
       first_call = pt.first_call;
       bt_destinations = pt.bt_destinations;
       phase = pt.phase;
+      ic_no = pt.ic_no;
+      claims = pt.claims;
+      workers = pt.workers;
+      lookahead = pt.lookahead;
       return *this;
     }
     double distance(double x1,double y1,double x2,double y2);
@@ -95,17 +161,27 @@ class PathPlannerGrid{
     //check for obstacles but excludes the black pixels obtained from apriltags
     void overlayGrid(std::vector<AprilTags::TagDetection> &detections,cv::Mat &grayImage);
     //find shortest traversal,populate path_points
-    void findshortest(AprilInterfaceAndVideoCapture &testbed);
+    void findshortest(WorldMapping &testbed);
     std::pair<int,int> setParentUsingOrientation(robot_pose &ps);
-    void addGridCellToPath(int r,int c,AprilInterfaceAndVideoCapture &testbed);
+    void addGridCellToPath(int r,int c,WorldMapping &testbed);
     bool isBlocked(int ngr, int ngc);
     int getWallReference(int r,int c,int pr, int pc);
-    void addBacktrackPointToStackAndPath(std::stack<std::pair<int,int> > &sk,std::vector<std::pair<int,int> > &incumbent_cells,int &ic_no,int ngr, int ngc,std::pair<int,int> &t,AprilInterfaceAndVideoCapture &testbed);
-    void BSACoverage(AprilInterfaceAndVideoCapture &testbed,robot_pose &ps);
-    int backtrackSimulateBid(std::pair<int,int> target,AprilInterfaceAndVideoCapture &testbed);
-    void BSACoverageIncremental(AprilInterfaceAndVideoCapture &testbed, robot_pose &ps,double reach_distance,vector<bot_config> &bots);
-    void findCoverageLocalNeighborPreference(AprilInterfaceAndVideoCapture &testbed,robot_pose &ps);
-    void findCoverageGlobalNeighborPreference(AprilInterfaceAndVideoCapture &testbed);
+    //wall is the wall reference of the new cell, computed here if -2
+    void addBacktrackPointToStackAndPath(std::stack<std::pair<int,int> > &sk,std::vector<std::pair<int,int> > &incumbent_cells,int &ic_no,int ngr, int ngc,std::pair<int,int> &t,WorldMapping &testbed,int wall = -2);
+    void BSACoverage(WorldMapping &testbed,robot_pose &ps);
+    int backtrackSimulateBid(std::pair<int,int> target,WorldMapping &testbed);
+    void BSACoverageIncremental(WorldMapping &testbed, robot_pose &ps,double reach_distance,std::vector<bot_config> &bots);
+    //BSACoverageIncremental in three parts for planning robots in parallel: propose only reads the shared map(and
+    //changes the robot's own cells while backtracking), commit applies a BSA_CLAIM or BSA_FIRST move once its cell is held,
+    //addBacktrackPoints then records the other open neighbors, backtrack runs the return phase across all bots
+    //points of the path after the one the robot is on, -1 if it is on none of the last lookahead ones
+    int pointsAhead(robot_pose &ps, double reach_distance);
+    bsa_move BSAProposeIncremental(WorldMapping &testbed, robot_pose &ps, double reach_distance);
+    void BSACommitIncremental(const bsa_move &move, WorldMapping &testbed, robot_pose &ps);
+    void BSAAddBacktrackPoints();
+    void BSABacktrackIncremental(WorldMapping &testbed, std::vector<bot_config> &bots);
+    void findCoverageLocalNeighborPreference(WorldMapping &testbed,robot_pose &ps);
+    void findCoverageGlobalNeighborPreference(WorldMapping &testbed);
     void drawPath(cv::Mat &image);
 };
 
@@ -114,8 +190,8 @@ class PathPlannerUser{
     std::vector<pt> path_points;
     std::vector<std::pair<int,int> > pixel_path_points;
     int total_points;
-    AprilInterfaceAndVideoCapture *testbed;
-    PathPlannerUser(AprilInterfaceAndVideoCapture *tb):total_points(0),testbed(tb){}
+    WorldMapping *testbed;
+    PathPlannerUser(WorldMapping *tb):total_points(0),testbed(tb){}
     void addPoint(int px, int py, double x,double y);
     void CallBackFunc(int event, int x, int y);
     void drawPath(cv::Mat &image);
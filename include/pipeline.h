@@ -0,0 +1,102 @@
+#ifndef PIPELINE_H
+#define PIPELINE_H
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <vector>
+#include "aprilvideointerface.h"
+
+//everything a frame carries from one pipeline stage to the next
+struct frame_packet{
+  long frame_id;//increases by one for every captured frame
+  frame_trace trace;//when the frame reached each stage, starting with its capture
+  cv::Mat image;
+  cv::Mat image_gray;
+  std::vector<AprilTags::TagDetection> detections;
+  int measured;//detections before this index were found in the image, the rest are predicted by the pose tracker
+  frame_packet():frame_id(-1),measured(0){}
+};
+
+//blocking queue of bounded size connecting two pipeline stages
+//push blocks while the queue is full so a slow stage holds back the ones before it
+//once closed, pushes fail and pops fail after the remaining items are drained
+//pushLatest never blocks either and drops the oldest item instead, for stages that only care about the newest frame
+template <class T>
+class BoundedQueue{
+  public:
+    BoundedQueue(int capacity):m_capacity(capacity),m_closed(false),m_dropped(0){}
+    bool push(T item){
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_not_full.wait(lock,[this]{ return m_closed || (int)m_items.size()<m_capacity; });
+      if(m_closed)
+        return false;
+      m_items.push_back(std::move(item));
+      m_not_empty.notify_one();
+      return true;
+    }
+    //never blocks, returns false if the item was dropped because the queue is full
+    bool tryPush(T item){
+      std::lock_guard<std::mutex> lock(m_mutex);
+      if(m_closed || (int)m_items.size()>=m_capacity)
+        return false;
+      m_items.push_back(std::move(item));
+      m_not_empty.notify_one();
+      return true;
+    }
+    //returns false only once closed
+    bool pushLatest(T item){
+      std::lock_guard<std::mutex> lock(m_mutex);
+      if(m_closed)
+        return false;
+      while((int)m_items.size()>=m_capacity){
+        m_items.pop_front();
+        m_dropped++;
+      }
+      m_items.push_back(std::move(item));
+      m_not_empty.notify_one();
+      return true;
+    }
+    bool pop(T &item){
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_not_empty.wait(lock,[this]{ return m_closed || !m_items.empty(); });
+      return take(item);
+    }
+    //waits at most timeout_ms milliseconds for an item
+    bool popFor(T &item, int timeout_ms){
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_not_empty.wait_for(lock,std::chrono::milliseconds(timeout_ms),[this]{ return m_closed || !m_items.empty(); });
+      return take(item);
+    }
+    void close(){
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_closed = true;
+      m_not_empty.notify_all();
+      m_not_full.notify_all();
+    }
+    int size(){
+      std::lock_guard<std::mutex> lock(m_mutex);
+      return m_items.size();
+    }
+    //items pushLatest replaced before they were popped
+    unsigned long dropped(){
+      std::lock_guard<std::mutex> lock(m_mutex);
+      return m_dropped;
+    }
+  private:
+    bool take(T &item){//m_mutex must be held
+      if(m_items.empty())
+        return false;
+      item = std::move(m_items.front());
+      m_items.pop_front();
+      m_not_full.notify_one();
+      return true;
+    }
+    std::deque<T> m_items;
+    int m_capacity;
+    bool m_closed;
+    unsigned long m_dropped;
+    std::mutex m_mutex;
+    std::condition_variable m_not_empty, m_not_full;
+};
+#endif
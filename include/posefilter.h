@@ -0,0 +1,122 @@
+#ifndef POSEFILTER_H
+#define POSEFILTER_H
+#include <vector>
+#include <mutex>
+#include <Eigen/Dense>
+#include "opencv2/opencv.hpp"
+#include "AprilTags/TagDetection.h"
+#include "structures.h"
+#include "worldmapping.h"
+
+//noise levels of the pose filter, in world units, radians and seconds
+struct pose_filter_params{
+  double position_sigma;//of a measured position
+  double heading_sigma;//of a measured heading
+  double accel_sigma;//how fast the speed changes between updates, per second
+  double turn_accel_sigma;//same for the turn rate
+  double command_sigma;//how closely the speed follows the wheel commands, the turn rate gets twice this over the axle length
+  double velocity_scale;//world units per second of one wheel velocity unit, 0 to ignore the commands
+  double axle_length;
+  pose_filter_params():position_sigma(0.5),heading_sigma(0.05),accel_sigma(20),turn_accel_sigma(3),
+    command_sigma(2),velocity_scale(0),axle_length(14.5){}
+};
+
+//extended kalman filter of a differential drive robot on the unicycle model, the state is
+//x, y, heading omega, speed v along the heading and turn rate w
+//the measurements are the poses found from the tag and the wheel commands sent to the robot
+class PoseFilter{
+  public:
+    typedef Eigen::Matrix<double,5,1> state;
+    typedef Eigen::Matrix<double,5,5> covariance;
+    pose_filter_params params;
+    state s;
+    covariance P;
+    double t;//time of the state
+    bool initialized;
+    PoseFilter(const pose_filter_params &p = pose_filter_params()):params(p),t(0),initialized(false){}
+    //moves the state forward to time t_to(earlier times are ignored)
+    void predict(double t_to);
+    //fuses a measured pose taken at time t_meas, the first one initializes the filter
+    void correct(const robot_pose &rp, double t_meas);
+    //fuses the wheel velocities sent at time t_cmd as a measurement of speed and turn rate
+    void command(int left, int right, double t_cmd);
+    //pose expected at time t_at, without changing the filter
+    robot_pose predicted(double t_at) const;
+    robot_pose pose() const;
+    //standard deviation of the position along its worst direction at time t_at
+    double positionSigma(double t_at) const;
+  private:
+    void ahead(double t_at, state &st, covariance &cov) const;
+    static void propagate(state &st, covariance &cov, double dt, const pose_filter_params &p);
+};
+
+//a filter per tag id together with the last detection of the tag, shared between the detection stage,
+//which asks where to look next, and the planning stage, which feeds it poses and commands
+class PoseTracker{
+  public:
+    pose_filter_params params;
+    double confident_sigma;//tracks with a smaller position sigma are trusted to skip detection
+    double max_age;//seconds after the last measurement a track is still predicted
+    double margin;//pixels added around every search window
+    PoseTracker():confident_sigma(2),max_age(0.5),margin(8),m_has_plane(false){}
+    //takes the image to world mapping of the current plane, so that predicted poses can be placed in the image
+    void setPlane(WorldMapping &mapping, int width, int height);
+    void correct(const AprilTags::TagDetection &det, const robot_pose &rp, double t);
+    void command(int id, int left, int right, double t);
+    //filtered pose of the tag at time t, false if the tag is not tracked
+    bool predict(int id, double t, robot_pose &rp);
+    //true if every live track is trusted at time t and at least one exists
+    bool confident(double t);
+    //pixel rectangles in which the live tracks are expected at time t, overlapping ones merged
+    void searchWindows(double t, int width, int height, std::vector<cv::Rect> &windows);
+    //appends to dets the expected detection of every live track that is not in it, moved to where the
+    //filter puts the tag at time t, so that a tag missed for a few frames is still planned for
+    void fillMissing(double t, std::vector<AprilTags::TagDetection> &dets);
+  private:
+    struct track{
+      PoseFilter filter;
+      AprilTags::TagDetection last;//last measured detection
+      robot_pose last_pose;//filtered pose at the time of the last detection
+      double t_last;
+      bool live;
+      track():t_last(0),live(false){}
+    };
+    track* find(int id, double t);//m_lock must be held
+    bool toPixel(const robot_pose &rp, double &px, double &py);
+    AprilTags::TagDetection moved(track &tr, double t);
+    std::vector<track> m_tracks;//indexed by tag id
+    Eigen::Matrix3d m_to_pixel;
+    bool m_has_plane;
+    std::mutex m_lock;
+};
+struct pose_sample{
+  double t;
+  robot_pose pose;
+};
+
+//the last few poses of every tag with the time they were taken, so that a loop running faster than the
+//camera can extrapolate the pose of a robot to the present
+class PoseHistory{
+  public:
+    double min_span;//seconds between the two samples the velocity is taken from, smooths the pose noise
+    double max_age;//a robot not seen for longer is not extrapolated
+    double max_horizon;//extrapolation stops this far past the newest sample
+    PoseHistory(int capacity = 16):min_span(0.1),max_age(0.5),max_horizon(0.25),m_capacity(capacity),m_newest(0){}
+    //samples older than the newest one of the tag are ignored
+    void add(int id, double t, const robot_pose &rp);
+    //pose of the tag at time t if it keeps its speed and turn rate, false if it has no recent sample
+    bool extrapolate(int id, double t, robot_pose &rp);
+    //time of the newest sample of any tag, 0 if there is none
+    double newest();
+  private:
+    struct ring{
+      std::vector<pose_sample> samples;
+      int next, count;
+      ring():next(0),count(0){}
+    };
+    std::vector<ring> m_rings;//indexed by tag id
+    int m_capacity;
+    double m_newest;
+    std::mutex m_lock;
+};
+#endif
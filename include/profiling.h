@@ -0,0 +1,90 @@
+#ifndef PROFILING_H
+#define PROFILING_H
+#include <vector>
+#include <string>
+#include <ostream>
+#include <mutex>
+#include "AprilTags/TagDetector.h"
+
+//histogram of durations with logarithmic buckets(8 per doubling, about 9% wide) from 1 microsecond up,
+//adding a sample is constant time and percentiles are accurate to a bucket
+class Histogram{
+  public:
+    Histogram();
+    void add(double seconds);
+    void clear();
+    //p in [0,1], returns the upper edge of the bucket holding that fraction of the samples
+    double percentile(double p) const;
+    unsigned long count() const{ return m_count; }
+    double mean() const{ return m_count ? m_sum/m_count : 0; }
+    double min() const{ return m_count ? m_min : 0; }
+    double max() const{ return m_max; }
+  private:
+    std::vector<unsigned long> m_buckets;
+    unsigned long m_count;
+    double m_sum, m_min, m_max;
+};
+
+//aggregates the per stage timings and counters reported by the tag detector over many frames
+class DetectorProfiler{
+  public:
+    DetectorProfiler();
+    void add(const AprilTags::TagDetectorStats &stats);
+    void clear();
+    unsigned long frames() const{ return m_frames; }
+    const Histogram& stage(int i) const{ return m_stages[i]; }
+    //one line per stage with mean, p50, p99 and max in milliseconds
+    void print(std::ostream &out) const;
+    void writeCSV(std::ostream &out) const;
+    void writeJSON(std::ostream &out) const;
+    //the format is picked by the extension, .json or anything else for csv
+    bool write(const std::string &path) const;
+    static const int STAGES = 12;
+    static const int COUNTERS = 6;
+    static const char *stage_names[STAGES];
+    static const char *counter_names[COUNTERS];
+  private:
+    Histogram m_stages[STAGES];
+    double m_counter_sums[COUNTERS];
+    int m_counter_max[COUNTERS];
+    unsigned long m_frames;
+};
+
+//stages a frame passes from the camera to the wheels
+enum trace_stage{TRACE_CAPTURED = 0, TRACE_DETECTED, TRACE_POSED, TRACE_PLANNED, TRACE_ENQUEUED, TRACE_WRITTEN, TRACE_STAGES};
+
+//when one frame reached every stage, on the tic() clock, 0 for the stages it has not reached
+struct frame_trace{
+  long frame_id;
+  double t[TRACE_STAGES];
+  frame_trace(){ reset(-1,0); }
+  void reset(long id, double t_capture);
+  void mark(int stage);
+};
+
+//latency histograms of the frames going through the control loop, from capture to every later stage and
+//between consecutive stages, the serial write happens on the writer thread and is matched by frame id
+class LatencyTracer{
+  public:
+    //takes the trace of a frame once the plan stage is done with it
+    void add(const frame_trace &trace);
+    //the first command computed from frame_id was enqueued, for commands sent after add() by another thread
+    void enqueued(long frame_id);
+    //the command frame built from frame_id has been handed to the port, only the first port counts
+    void written(long frame_id);
+    unsigned long frames();
+    //capture to stage, in seconds
+    double percentile(int stage, double p);
+    //one line per stage with mean, p50, p99 and max in milliseconds
+    void print(std::ostream &out);
+    bool write(const std::string &path);//csv
+    static const char *stage_names[TRACE_STAGES];
+  private:
+    static const int PENDING = 64;//frames waiting for their serial write
+    std::mutex m_lock;
+    Histogram m_since_capture[TRACE_STAGES];
+    Histogram m_step[TRACE_STAGES];//from the previous stage the frame reached
+    frame_trace m_pending[PENDING];
+    void addStage(const frame_trace &trace, int stage);
+};
+#endif
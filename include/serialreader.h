@@ -0,0 +1,38 @@
+#ifndef SERIALREADER_H
+#define SERIALREADER_H
+#include <functional>
+#include <thread>
+#include <atomic>
+#include <vector>
+
+//reads a serial port(or any file descriptor) from its own thread, sleeping in poll() until data arrives
+//bytes are read in bulk into a ring buffer and every complete frame, ending with the delimiter byte, is
+//handed to the callback(delimiter included), frames longer than max_frame are delivered in pieces
+class SerialReader{
+  public:
+    typedef std::function<void(const unsigned char*, int)> FrameCallback;
+    SerialReader(int buffer_size = 4096, int max_frame = 300);
+    ~SerialReader();
+    //the descriptor is not owned and must stay open until stop() returns
+    void start(int fd, unsigned char delimiter, FrameCallback cb);
+    void stop();
+    unsigned long bytesRead() const{ return m_bytes; }
+    unsigned long framesRead() const{ return m_frames; }
+    unsigned long overflows() const{ return m_overflows; }
+  private:
+    void run();
+    void extractFrames();
+    int m_fd;
+    int m_wake[2];//self pipe used to interrupt poll on stop
+    unsigned char m_delimiter;
+    FrameCallback m_callback;
+    std::vector<unsigned char> m_ring;
+    size_t m_head, m_count;//start and number of unconsumed bytes in the ring
+    size_t m_scanned;//bytes from head already known not to contain the delimiter
+    std::vector<unsigned char> m_frame;//linear copy of a frame that wraps around the ring
+    int m_max_frame;
+    std::thread m_thread;
+    std::atomic<bool> m_running;
+    std::atomic<unsigned long> m_bytes, m_frames, m_overflows;
+};
+#endif
@@ -0,0 +1,67 @@
+#ifndef SERIALWRITER_H
+#define SERIALWRITER_H
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include "Serial.h"
+#include "commandframe.h"
+#include "lockfree.h"
+
+struct serial_message{
+  long tag;//passed to the written callback, e.g. the frame the message was built from
+  unsigned long epoch;//queued messages sent up to this one
+  int len;
+  unsigned char data[FRAME_MAX_SIZE];
+};
+
+struct serial_writer_stats{
+  int queue_depth;//messages waiting in the queue
+  unsigned long sent;//messages written to the port
+  unsigned long dropped;//messages rejected because the queue was full
+  unsigned long coalesced;//latest values overwritten before they could be written
+  unsigned long bytes;
+};
+
+//writes to a serial port from a dedicated thread so that the caller never blocks on the port
+//send() queues a message, sendLatest() replaces the pending latest value(meant for velocity
+//commands where only the newest matters), the latest value is written before the queued messages
+//sent after it, and dropped if one was, so that e.g. a stop is never followed by the velocities it replaced
+//only one thread may call send/sendLatest
+class AsyncSerialWriter{
+  public:
+    AsyncSerialWriter(int capacity = 64);
+    ~AsyncSerialWriter();
+    // open the port and start the writer thread
+    void open(const std::string& port, int rate = 9600);
+    //called on the writer thread after every message is written, set it before open()
+    void onWritten(std::function<void(long tag)> callback){ m_on_written = callback; }
+    //returns false if the message was dropped
+    bool send(const unsigned char* buf, int len, long tag = -1);
+    void sendLatest(const unsigned char* buf, int len, long tag = -1);
+    //blocks until everything handed over so far has been written
+    void flush();
+    void stop();
+    serial_writer_stats stats() const;
+    //the underlying port, e.g. to read telemetry from the same descriptor
+    const Serial& port() const{ return m_serial; }
+  private:
+    void run();
+    void write(const serial_message &msg);
+    void wake();
+    Serial m_serial;
+    SpscQueue<serial_message> m_queue;
+    TripleBuffer<serial_message> m_latest;
+    std::thread m_thread;
+    std::mutex m_mutex;//only used to sleep on the condition variable
+    std::condition_variable m_cond;
+    std::atomic<bool> m_running;
+    std::atomic<unsigned long> m_sent, m_dropped, m_coalesced, m_bytes;
+    std::atomic<unsigned long> m_handed, m_done;//messages given to and finished by the writer thread, used by flush
+    std::atomic<unsigned long> m_epoch;//messages queued so far
+    unsigned long m_written;//epoch of the last queued message written, owned by the writer thread
+    std::function<void(long tag)> m_on_written;
+};
+#endif
@@ -0,0 +1,113 @@
+#ifndef SESSIONLOG_H
+#define SESSIONLOG_H
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <mutex>
+#include <stdint.h>
+#include "opencv2/opencv.hpp"
+#include "AprilTags/TagDetection.h"
+#include "structures.h"
+#include "commandframe.h"
+
+//append only log of a run, so that it can be replayed offline through the same pipeline
+//
+//file layout:
+//  8 bytes         SESSION_MAGIC
+//  records, each a session_record_header followed by length bytes of payload
+//    SESSION_FRAME       int32 rows, cols, encoding, then the pixels(rows*cols bytes) or the png data
+//    SESSION_DETECTIONS  uint32 count, then count session_detection
+//    SESSION_POSES       uint32 count, then count session_pose
+//    SESSION_COMMANDS    uint32 sequence number, uint32 count, then count session_command
+//every record carries the id of the frame it belongs to and a time, the capture time for frames and
+//the time of writing for the rest, values are stored in host byte order
+//a record cut short by a crash is ignored by the reader
+#define SESSION_MAGIC "DDSESS01"
+
+enum session_record_type{SESSION_FRAME = 1, SESSION_DETECTIONS, SESSION_POSES, SESSION_COMMANDS};
+enum session_frame_encoding{SESSION_RAW = 0, SESSION_PNG};
+
+struct session_record_header{
+  uint32_t type;
+  uint32_t length;//payload bytes
+  int64_t frame_id;
+  double time;
+};
+
+struct session_detection{
+  int64_t obs_code, code;
+  int32_t id, hamming_distance, rotation, good;
+  float p[4][2];
+  float cxy[2], hxy[2];
+  float observed_perimeter;
+  double homography[9];//row major
+};
+
+struct session_pose{
+  int32_t id;//tag id of the robot
+  double x, y, omega;
+};
+
+struct session_command{
+  int32_t id, left, right;
+};
+
+//conversion of a detection to and from its stored form
+void packDetection(const AprilTags::TagDetection &d, session_detection &s);
+void unpackDetection(const session_detection &s, AprilTags::TagDetection &d);
+
+class SessionWriter{
+  public:
+    SessionWriter();
+    ~SessionWriter();
+    //compress stores the frames as png, which is lossless but costs time while recording
+    bool open(const std::string& path, bool compress = false);
+    void close();
+    bool isOpened() const{ return m_file != NULL; }
+    void writeFrame(long frame_id, double t_capture, const cv::Mat &gray);
+    void writeDetections(long frame_id, const std::vector<AprilTags::TagDetection> &dets);
+    void writePoses(long frame_id, const std::vector<session_pose> &poses);
+    //may be called from another thread than the other writes, e.g. a control loop of its own
+    void writeCommands(long frame_id, unsigned char seq, const std::vector<bot_command> &commands);
+    unsigned long bytesWritten() const{ return m_bytes; }
+  private:
+    void writeRecord(uint32_t type, long frame_id, double time, const void *a, size_t a_len, const void *b = NULL, size_t b_len = 0);
+    FILE *m_file;
+    bool m_compress;
+    std::vector<unsigned char> m_buf;//reused for encoding records
+    std::vector<unsigned char> m_command_buf;//same for the commands
+    std::mutex m_lock;//keeps records whole when written from two threads
+    unsigned long m_bytes;
+};
+
+struct session_record{
+  session_record_header header;
+  const unsigned char *payload;//points into the mapped file
+};
+
+//memory maps a session log and walks through its records without copying them
+class SessionReader{
+  public:
+    SessionReader();
+    ~SessionReader();
+    bool open(const std::string& path);
+    void close();
+    bool isOpened() const{ return m_data != NULL; }
+    //start again from the first record
+    void rewind();
+    //returns false at the end of the log
+    bool next(session_record &rec);
+    //skips to the next frame record, the raw pixels are not copied and stay valid until close(),
+    //writing to them only changes this process' private copy of the page
+    bool nextFrame(cv::Mat &gray, long &frame_id, double &t_capture);
+    //decoding of the payload of a record of the matching type
+    static void frame(const session_record &rec, cv::Mat &gray);
+    static void detections(const session_record &rec, std::vector<AprilTags::TagDetection> &dets);
+    static void poses(const session_record &rec, std::vector<session_pose> &poses);
+    static void commands(const session_record &rec, unsigned char &seq, std::vector<bot_command> &commands);
+  private:
+    unsigned char *m_data;
+    size_t m_size;
+    size_t m_pos;
+};
+#endif
@@ -43,11 +43,12 @@ struct bt{
   std::stack<std::pair<int,int> > stack_state;
   int manhattan_distance;//distance of robot from this point's parent(returning distance)
   bool valid;
-  bt(){valid = true;}
+  bt(){valid = true;manhattan_distance = -1;}
   bt(int pr,int pc, int r, int c, std::stack<std::pair<int,int> > sk){
     parent.first = pr, parent.second = pc, next_p.first = r, next_p.second = c;
     stack_state = sk;
     valid = true;
+    manhattan_distance = -1;//points invalidated before being measured are still sorted on it
   }
 };
 #endif
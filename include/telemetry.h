@@ -0,0 +1,89 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <vector>
+#include <string>
+#include <cstdio>
+#include <cstddef>
+
+//lowest level that is compiled in, the log calls below it expand to nothing, set with -DTELEMETRY_LEVEL
+#define TELEMETRY_DEBUG 0
+#define TELEMETRY_INFO 1
+#define TELEMETRY_WARN 2
+#define TELEMETRY_ERROR 3
+#ifndef TELEMETRY_LEVEL
+#define TELEMETRY_LEVEL TELEMETRY_INFO
+#endif
+
+enum telemetry_kind{TELEMETRY_LOG = 0, TELEMETRY_METRIC};
+
+struct telemetry_record{
+  double time;
+  int level;
+  int kind;
+  double value;//metrics only
+  char text[104];//the message, or the name of the metric, cut short if longer
+};
+
+//event and metric channel for the control loop, producers format into a slot of a lock free ring
+//and never block or touch the terminal, a background thread drains the ring to a file or stdout
+//when the ring is full new records are dropped and counted
+class Telemetry{
+  public:
+    //the process wide channel, draining to stdout until open() is called
+    static Telemetry& instance();
+    Telemetry(int capacity = 4096);//rounded up to a power of two
+    ~Telemetry();
+    //writes to path from now on, "-" for stdout and "" to discard, returns false if it can't be opened
+    bool open(const std::string &path);
+    //printf style message, safe to call from any number of threads
+    void log(int level, const char *format, ...) __attribute__((format(printf,3,4)));
+    void metric(const char *name, double value);
+    unsigned long dropped() const{ return m_dropped.load(std::memory_order_relaxed); }
+    //writes out everything queued so far, waits for the drain thread
+    void flush();
+    void stop();
+  private:
+    struct slot{
+      std::atomic<size_t> seq;//which lap of the ring the slot is ready for
+      telemetry_record rec;
+    };
+    slot* claim(size_t &pos);
+    void publish(slot *s, size_t pos);
+    bool pop(telemetry_record &rec);
+    void drain();
+    void write(const telemetry_record &rec);
+    std::vector<slot> m_slots;
+    size_t m_mask;
+    std::atomic<size_t> m_head;//next slot for the producers
+    size_t m_tail;//next slot for the drain thread
+    std::atomic<unsigned long> m_dropped;
+    std::atomic<unsigned long> m_drained;
+    std::atomic<bool> m_running;
+    std::mutex m_out_lock;//only between the drain thread and open(), producers never take it
+    FILE *m_out;
+    FILE *m_file;//owned output, closed on reopen
+    std::thread m_thread;
+};
+
+#if TELEMETRY_LEVEL <= TELEMETRY_DEBUG
+#define TLOG_DEBUG(...) Telemetry::instance().log(TELEMETRY_DEBUG,__VA_ARGS__)
+#else
+#define TLOG_DEBUG(...) do{}while(0)
+#endif
+#if TELEMETRY_LEVEL <= TELEMETRY_INFO
+#define TLOG_INFO(...) Telemetry::instance().log(TELEMETRY_INFO,__VA_ARGS__)
+#define TMETRIC(name,value) Telemetry::instance().metric(name,value)
+#else
+#define TLOG_INFO(...) do{}while(0)
+#define TMETRIC(name,value) do{}while(0)
+#endif
+#if TELEMETRY_LEVEL <= TELEMETRY_WARN
+#define TLOG_WARN(...) Telemetry::instance().log(TELEMETRY_WARN,__VA_ARGS__)
+#else
+#define TLOG_WARN(...) do{}while(0)
+#endif
+#define TLOG_ERROR(...) Telemetry::instance().log(TELEMETRY_ERROR,__VA_ARGS__)
+#endif
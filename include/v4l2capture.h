@@ -0,0 +1,38 @@
+#ifndef V4L2CAPTURE_H
+#define V4L2CAPTURE_H
+#include <string>
+#include <vector>
+#include "opencv2/opencv.hpp"
+
+//streams frames straight from a V4L2 device through mmap'd driver buffers, asking the camera for YUYV so
+//that the gray image the detector needs is just the Y plane, no BGR frame is ever built
+//a regular file of back to back raw YUYV frames can be opened instead of a device(file backed stand-in
+//for testing without a camera), it is replayed in a loop
+class V4L2Capture{
+  public:
+    V4L2Capture();
+    ~V4L2Capture();
+    //returns false if the device could not be set up, width and height are updated to what the driver chose
+    bool open(const std::string& path, int &width, int &height, int buffer_count = 4);
+    void close();
+    bool isOpened() const{ return m_fd >= 0; }
+    //waits for the next frame and writes its Y plane to gray(CV_8UC1), timestamp is the time the
+    //driver captured the frame, in seconds on the same clock as tic()
+    bool grab(cv::Mat &gray, double &timestamp);
+    int bufferCount() const{ return m_buffers.size(); }
+    unsigned long framesGrabbed() const{ return m_frames; }
+  private:
+    bool openDevice(int &width, int &height, int buffer_count);
+    bool openFile();
+    struct buffer{
+      void *start;
+      size_t length;
+    };
+    int m_fd;
+    bool m_file;//stand-in file instead of a device
+    int m_width, m_height;
+    std::vector<buffer> m_buffers;//driver buffers, or the whole file for the stand-in
+    size_t m_file_frame;//next frame to read from the file
+    unsigned long m_frames;
+};
+#endif
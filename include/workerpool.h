@@ -0,0 +1,34 @@
+#ifndef WORKERPOOL_H
+#define WORKERPOOL_H
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+
+//threads started once and kept waiting for work, run spreads the indexes of a job over them and the calling
+//thread, so that work split up several times a frame doesn't pay for starting threads every time
+class WorkerPool{
+  public:
+    WorkerPool():m_job(NULL),m_n(0),m_next(0),m_busy(0),m_generation(0),m_stop(false){}
+    ~WorkerPool(){ resize(1); }
+    //threads counts the calling thread, 1 stops every worker
+    void resize(int threads);
+    int threads() const{ return m_threads.size()+1; }
+    //calls f(0...n-1) and returns once every call returned, not to be called from inside f
+    void run(int n, const std::function<void(int)> &f);
+  private:
+    void work();
+    void loop(unsigned seen);
+    std::vector<std::thread> m_threads;
+    std::mutex m_lock;
+    std::condition_variable m_wake, m_done;
+    const std::function<void(int)> *m_job;
+    int m_n;
+    std::atomic<int> m_next;//next index to take
+    int m_busy;//workers still on the current job
+    unsigned m_generation;//bumped for every job, a worker waits for it to change
+    bool m_stop;
+};
+#endif
@@ -0,0 +1,26 @@
+#ifndef WORLDMAPPING_H
+#define WORLDMAPPING_H
+#include <vector>
+#include <Eigen/Dense>
+#include "AprilTags/TagDetection.h"
+
+//all a planner needs from the testbed: the tags seen in the current frame and the mapping of image
+//pixels onto the world plane, so planning can run without a camera on replayed or simulated detections
+class WorldMapping{
+  public:
+    std::vector<AprilTags::TagDetection> detections;
+    virtual ~WorldMapping(){}
+    virtual void pixelToWorld(double x,double y,double &xd,double &yd) = 0;
+};
+
+//pixel to plane mapping through a 3x3 homography, identity by default so that world coordinates are pixels
+class HomographyMapping : public WorldMapping{
+  public:
+    Eigen::Matrix3d H;
+    HomographyMapping():H(Eigen::Matrix3d::Identity()){}
+    void pixelToWorld(double x,double y,double &xd,double &yd);
+    //takes over the mapping of another one(the camera's plane mapping is projective, so this is exact)
+    //from the corners of a width x height image, H can then be stored and reused without the camera
+    void fit(WorldMapping &mapping, int width, int height);
+};
+#endif
@@ -0,0 +1,103 @@
+//attaches to the frame bus of a running sandbox(-M) and shows the frames with their detections and poses,
+//or prints the poses, without ever holding the sandbox back
+#include <iostream>
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <thread>
+#include <chrono>
+#include <unistd.h>
+#include "opencv2/opencv.hpp"
+#include "framebus.h"
+using namespace std;
+
+const string usage = "\n"
+  "Usage:\n"
+  "  busview [OPTION...]\n"
+  "\n"
+  "Options:\n"
+  "  -h  -?          Show help options\n"
+  "  -M <name>       Bus to attach to (default " FRAMEBUS_DEFAULT_NAME ")\n"
+  "  -p              Print the poses of every frame instead of showing the frames\n"
+  "\n";
+
+int main(int argc, char* argv[]){
+  string name = FRAMEBUS_DEFAULT_NAME;
+  bool print = false;
+  int opt;
+  while((opt = getopt(argc,argv,":h?M:p")) != -1){
+    switch(opt){
+      case 'h':
+      case '?':
+        cout << usage;
+        exit(0);
+      case 'M': name = optarg; break;
+      case 'p': print = true; break;
+      case ':':
+        cout << usage;
+        exit(1);
+    }
+  }
+
+  FrameBusReader bus;
+  while(!bus.open(name)){
+    cerr << "waiting for the bus " << name << endl;
+    this_thread::sleep_for(chrono::seconds(1));
+  }
+  const char *windowName = "busview";
+  if(!print)
+    cv::namedWindow(windowName,cv::WINDOW_NORMAL);
+  framebus_view view;
+  vector<AprilTags::TagDetection> dets;
+  vector<session_pose> poses;
+  cv::Mat image;
+  long last_frame = -1;
+  unsigned long torn = 0;
+  while(true){
+    if(!bus.latest(view) || view.slot->frame_id == last_frame){
+      if(print)
+        this_thread::sleep_for(chrono::milliseconds(5));
+      else if(cv::waitKey(5) == 27)
+        break;
+      continue;
+    }
+    long frame_id = view.slot->frame_id;
+    double t_capture = view.slot->t_capture;
+    FrameBusReader::poses(view,poses);
+    if(print){
+      if(!bus.valid(view)){
+        torn++;
+        continue;
+      }
+      printf("frame %ld at %.6f:",frame_id,t_capture);
+      for(int i = 0;i<poses.size();i++)
+        printf(" %d(%.1f %.1f %.2f)",poses[i].id,poses[i].x,poses[i].y,poses[i].omega);
+      printf("\n");
+      fflush(stdout);
+    }
+    else{
+      //the only copy, drawing needs a writable color image anyway
+      if(view.gray.empty())
+        image = cv::Mat(480,640,CV_8UC3,cv::Scalar(0,0,0));
+      else
+        cv::cvtColor(view.gray,image,CV_GRAY2BGR);
+      FrameBusReader::detections(view,dets);
+      if(!bus.valid(view)){
+        torn++;
+        continue;//the sandbox wrapped around onto the slot while it was copied
+      }
+      for(int i = 0;i<dets.size();i++)
+        dets[i].draw(image);
+      char text[64];
+      snprintf(text,sizeof(text),"frame %ld, %d robots",frame_id,(int)poses.size());
+      cv::putText(image,text,cv::Point(10,20),cv::FONT_HERSHEY_PLAIN,1.2,cv::Scalar(0,255,0));
+      cv::imshow(windowName,image);
+      if(cv::waitKey(1) == 27)
+        break;
+    }
+    last_frame = frame_id;
+  }
+  if(torn)
+    cerr << torn << " frames were overwritten while being read and skipped" << endl;
+  return 0;
+}
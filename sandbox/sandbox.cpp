@@ -4,9 +4,78 @@
 #include "controllers.h"
 // For Arduino: serial port access class
 #include "Serial.h"
+#include "serialwriter.h"
+#include "serialreader.h"
+#include "commandframe.h"
+#include "pipeline.h"
+#include "framegrabber.h"
+#include "sessionlog.h"
+#include "telemetry.h"
+#include "posefilter.h"
+#include "overlay.h"
+#include "fleet.h"
+#include <thread>
+#include <atomic>
+#include <memory>
+#include <csignal>
+#include <cstring>
 using namespace std;
 using namespace cv;
 
+//SIGINT and SIGTERM end the run like escape does, stop frames included, the flag is all the handler touches
+static atomic<bool> stop_requested(false);
+static void requestStop(int){
+  stop_requested = true;
+}
+
+//the paths and tag ids of every slot as planned on one frame, never changed once published to the control loop
+struct fleet_paths{
+  vector<vector<pt> > paths;
+  vector<int> ids;
+  vector<unsigned> generations;//FleetRegistry::generation when the paths were planned
+};
+
+//packs the commands of all robots in one frame and hands it to the writer of every port
+//velocity frames only keep the latest value, stop frames are queued so that they are never coalesced away
+//tag is the id of the frame the commands were computed from, for the latency trace
+void broadcastCommands(vector<AsyncSerialWriter> &ports, vector<bot_command> &commands, unsigned char seq, bool latest = true, long tag = -1){
+  static unsigned char buf[FRAME_MAX_SIZE];
+  int len = encodeCommandFrame(seq,commands.data(),commands.size(),buf);
+  if(len<0){
+    TLOG_WARN("too many robots for one command frame");
+    return;
+  }
+  for(int i = 0;i<ports.size();i++){
+    if(latest)
+      ports[i].sendLatest(buf,len,tag);
+    else
+      ports[i].send(buf,len,tag);
+  }
+}
+
+//for the thread stepping the controllers, ids and generations are by slot as it last got them from the registry,
+//stepped_ids and stepped as it stepped them before, a robot that left its slot is given a stop in stops(its
+//firmware keeps driving at the last velocity it received and no later frame carries its id) and the controller
+//of a slot that changed starts over for the robot now in it
+void syncSlots(vector<bot_config> &bots, const vector<int> &ids, const vector<unsigned> &generations,
+    vector<int> &stepped_ids, vector<unsigned> &stepped, vector<bot_command> &stops){
+  stops.clear();
+  stepped_ids.resize(ids.size(),-1);
+  stepped.resize(ids.size(),0);
+  for(int i = 1;i<ids.size();i++){//0 is for origin
+    if(generations[i] == stepped[i])
+      continue;
+    if(stepped_ids[i]>=0){
+      bot_command c;
+      c.id = stepped_ids[i];
+      c.left = c.right = 0;
+      stops.push_back(c);
+    }
+    bots[i].control.reset();
+    stepped_ids[i] = ids[i];
+    stepped[i] = generations[i];
+  }
+}
 
 int main(int argc, char* argv[]) {
   AprilInterfaceAndVideoCapture testbed;
@@ -19,151 +88,505 @@ int main(int argc, char* argv[]) {
   }
   cout << "Processing video" << endl;
   testbed.setupVideo();
-  int frame = 0;
-  int first_iter = 1;
-  double last_t = tic();
+  struct sigaction sa;
+  memset(&sa,0,sizeof(sa));
+  sa.sa_handler = requestStop;
+  sigemptyset(&sa.sa_mask);
+  sa.sa_flags = SA_RESTART | SA_RESETHAND;//a second signal kills the process if the shutdown hangs
+  sigaction(SIGINT,&sa,NULL);
+  sigaction(SIGTERM,&sa,NULL);
+  //with -d the run is headless: no window and no waitKey, so no display is needed and only capture paces the loop
   const char *windowName = "What do you see?";
-  cv::namedWindow(windowName,WINDOW_NORMAL);
-  vector<Serial> s_transmit(2);
+  if(testbed.m_draw)
+    cv::namedWindow(windowName,WINDOW_NORMAL);
+  vector<AsyncSerialWriter> s_transmit(2);
+  vector<SerialReader> s_receive(s_transmit.size());
   ostringstream sout;
+  //capture to wheel command latency of every frame, the serial writers report when a command frame went out
+  LatencyTracer tracer;
   if(testbed.m_arduino){
     for(int i = 0;i<s_transmit.size();i++){
       sout.str("");
       sout.clear();
       sout<<"/dev/ttyUSB"<<i;
+      s_transmit[i].onWritten([&tracer](long tag){ tracer.written(tag); });
       s_transmit[i].open(sout.str(),9600);
+      //robots report telemetry(encoder counts, battery) as newline terminated lines
+      s_receive[i].start(s_transmit[i].port().fd(),'\n',[i](const unsigned char *buf, int len){
+          while(len && (buf[len-1] == '\n' || buf[len-1] == '\r'))
+            len--;
+          TLOG_INFO("telemetry on port %d: %.*s",i,len,(const char*)buf);
+          });
     }
   }
-  cv::Mat image;
-  cv::Mat image_gray;
   //make sure that lookahead always contain atleast the next path point
   //if not then the next point to the closest would automatically become target
   //PurePursuitController controller(40.0,2.0,14.5,70,70,128,false);
   //PurePursuitController controller(20.0,2.0,14.5,70,70,128,true);
   //PathPlannerUser path_planner(&testbed);
   //setMouseCallback(windowName, path_planner.CallBackFunc, &path_planner);
-  int robotCount;
-  int max_robots = 3;
   int origin_tag_id = 0;//always 0
-  //tag id should also not go beyond max_robots
   vector<vector<nd> > tp;//a map that would be shared among all
-  vector<bot_config> bots(max_robots,bot_config(60,60,120,tp,40.0,2.3,14.5,75,75,128,false));
+  bot_config proto(60,60,120,tp,40.0,2.3,14.5,75,75,128,false);
+  //with -U the controllers steer from where the robot will be, not where it was seen
+  proto.control.velocity_scale = testbed.m_velocityScale;
+  proto.control.latency = testbed.m_commandLatency;
+  //with -w the planners stay a few cells ahead of the robots
+  proto.plan.lookahead = testbed.m_lookahead;
+  //robots are registered by tag id as they show up and retired when gone for a while, the origin always
+  //has slot 0, everything below indexes bots by slot and bots[s].id is the tag id(-1 for a free slot)
+  FleetRegistry fleet_registry(testbed.m_maxRobots+1,proto);
+  fleet_registry.add(origin_tag_id,0,true);
+  vector<bot_config> &bots = fleet_registry.bots;
+  //with -j the robots are planned in parallel, claiming the cells of the shared map atomically
+  FleetPlanner fleet_planner(testbed.m_planThreads);
+  //optionally log everything the loop sees and sends so that the run can be replayed offline with -P
+  SessionWriter session;
+  vector<session_pose> poses;
+  //with -M every frame is published on a shared memory bus as well, for a viewer or logger in another process
+  FrameBusWriter bus;
+  if(!testbed.m_recordPath.empty() && !session.open(testbed.m_recordPath,testbed.m_compressRecord)){
+    cerr<<"ERROR: can't record to "<<testbed.m_recordPath<<endl;
+    return 1;
+  }
+  //with -A the origin tag is a static anchor, its plane is solved only until it has been averaged and locked
+  if(testbed.m_anchorFrames>0)
+    testbed.m_anchors.addStatic(origin_tag_id);
+  fleet_stimuli fleet;//controller inputs and outputs for all bots, stepped together
+  //with -K the robots are tracked by a pose filter, which lets the detect stage search only around the predicted
+  //poses or skip a frame altogether, and keeps a robot missed for a few frames moving on its predicted pose
+  PoseTracker pose_tracker;
+  pose_tracker.params.velocity_scale = testbed.m_velocityScale;
+  pose_tracker.params.axle_length = bots[0].control.axle_length;
+  atomic<unsigned long> full_detections(0), window_detections(0), skipped_detections(0);
+  //with -Q the controllers run in a thread of their own at a fixed rate on poses extrapolated to the present from
+  //the pose history, the plan stage only publishes the poses and paths of every frame for it
+  bool control_loop = testbed.m_arduino && testbed.m_controlRate>0;
+  PoseHistory pose_history;
+  //the paths of every frame are swapped in whole through an atomic pointer, so the control loop never waits on the
+  //plan stage and always steers along one frame's paths
+  shared_ptr<fleet_paths> published_paths;
+  atomic<long> vision_frame(-1);//newest frame published to the control loop
+  //the grid and the paths are kept drawn on a layer of their own, a drawn frame costs only a masked copy of it,
+  //and with -I only every few frames are drawn at all
+  OverlayCompositor overlay;
+  vector<bot_command> commands;
+  unsigned char frame_seq = 0;
 
-  while (true){
-    for(int i = 0;i<max_robots;i++){
-      bots[i].init();
-      bots[i].id = i;//0 is saved for origin
-    }
-    robotCount = 0;
-    testbed.m_cap >> image;
-    //image = imread("tagimage.jpg");
-
-    testbed.processImage(image, image_gray);//tags extracted and stored in class variable
-    int n = testbed.detections.size();
-    for(int i = 0;i<bots.size();i++){
-      bots[i].plan.robot_tag_id = i;
-    }
-    for(int i = 0;i<n;i++){
-      bots[testbed.detections[i].id].plan.robot_id = i;
-      if(testbed.detections[i].id == origin_tag_id){//plane extracted
-        bots[testbed.detections[i].id].plan.robot_id = i;
-        testbed.extractPlane(i);
-        break;
-      }
-    }
-    if(bots[origin_tag_id].plan.robot_id<0)
-      continue;//can't find the origin tag to extract plane
-    for(int i = 0;i<n;i++){
-      if(testbed.detections[i].id != origin_tag_id){//robot or goal
-        if(robotCount>=10){
-          cout<<"too many robots found"<<endl;
+  //the frame loop runs as a pipeline with every stage in its own thread, connected by bounded queues:
+  //capture -> detect -> plan(poses, coverage, control and transmit) -> display(main thread, as highgui wants)
+  //detection of frame n+1 then overlaps with planning of frame n and the slowest stage bounds the frame rate
+  //in latest frame mode the queues before planning hold a single frame which a newer one replaces, a frame left
+  //waiting behind a slower stage would be stale by the time that stage got to it
+  int depth = testbed.m_latestOnly ? 1 : 2;
+  BoundedQueue<frame_packet> captured(depth), detected(depth), drawn(2);
+  atomic<bool> running(true);
+
+  //in latest frame mode a grabber thread keeps the camera drained and the capture stage only takes the newest
+  //frame, so a stage running slower than the camera never works on a frame that sat in the driver's queue
+  LatestFrameGrabber grabber;
+  if(testbed.m_latestOnly)
+    grabber.start(testbed);
+  thread capture_stage([&](){
+    long frame_id = 0;
+    grabbed_frame latest;
+    while(running){
+      frame_packet packet;
+      if(testbed.m_latestOnly){
+        if(!grabber.latest(latest))
           break;
+        packet.image = latest.image;
+        packet.image_gray = latest.image_gray;
+        packet.frame_id = latest.frame_id;//ids of skipped frames are missing
+        packet.trace.reset(packet.frame_id,latest.t_capture);
+      }
+      else{
+        double t_capture;
+        if(!testbed.grabFrame(packet.image,packet.image_gray,t_capture)){
+          if(testbed.m_replay.isOpened())
+            break;//end of the replayed session
+          continue;
         }
-        robotCount++;
-        testbed.findRobotPose(i,bots[testbed.detections[i].id].pose);//i is the index in detections for which to find pose
+        //packet.image = imread("tagimage.jpg");
+        packet.frame_id = frame_id++;
+        packet.trace.reset(packet.frame_id,t_capture);
       }
+      if(!(testbed.m_latestOnly ? captured.pushLatest(packet) : captured.push(packet)))
+        break;
     }
+    captured.close();//lets the later stages drain and finish
+  });
 
-    //all robots must be detected(in frame) when overlay grid is called else some regions on which a robot is 
-    //present(but not detected) would be considered an obstacle
-    //no two robots must be present in the same grid cell(result is undefined)
-    if(first_iter){
-      first_iter = 0;
-      bots[0].plan.overlayGrid(testbed.detections,image_gray);//overlay grid completely reintialize the grid, we have to call it once at the beginning only when all robots first seen simultaneously(the surrounding is assumed to be static) not every iteration
-      for(int i = 1;i<bots.size();i++){
-        bots[i].plan.rcells = bots[0].plan.rcells;
-        bots[i].plan.ccells = bots[0].plan.ccells;
+  thread detect_stage([&](){
+    frame_packet packet;
+    int since_full = 0;
+    bool skip_next = false;
+    vector<cv::Rect> windows;
+    while(captured.pop(packet)){
+      double t = packet.trace.t[TRACE_CAPTURED];
+      if(!testbed.m_predictEvery || ++since_full>=testbed.m_predictEvery || !pose_tracker.confident(t)){
+        testbed.detectTags(packet.image, packet.image_gray, packet.detections);
+        full_detections++;
+        since_full = 0;
+        skip_next = true;
+      }
+      else if(skip_next){//the predictions alone are used for this frame
+        if(!packet.image.empty())
+          cv::cvtColor(packet.image,packet.image_gray,CV_BGR2GRAY);
+        packet.detections.clear();
+        skipped_detections++;
+        skip_next = false;
       }
+      else{
+        pose_tracker.searchWindows(t,packet.image_gray.cols ? packet.image_gray.cols : packet.image.cols,
+            packet.image_gray.rows ? packet.image_gray.rows : packet.image.rows,windows);
+        testbed.detectTagsInWindows(packet.image, packet.image_gray, windows, packet.detections);
+        window_detections++;
+        skip_next = true;
+      }
+      packet.measured = packet.detections.size();
+      if(testbed.m_predictEvery)
+        pose_tracker.fillMissing(t,packet.detections);
+      packet.trace.mark(TRACE_DETECTED);
+      if(!(testbed.m_latestOnly ? detected.pushLatest(packet) : detected.push(packet)))
+        break;
     }
+    detected.close();
+  });
 
-    for(int i = 0;i<bots.size();i++){
-      //for bot 0, the origin and robot index would be the same
-      bots[i].plan.origin_id = bots[0].plan.robot_id;//set origin index of every path planner which is the index of tag 0 in detections vector given by RHS
-    }
+  thread plan_stage([&](){
+    int frame = 0;
+    int first_iter = 1;
+    vector<int> slots;//slot of every detection, -1 if the fleet was full
+    vector<int> slot_ids, stepped_ids;//tag id by slot, now and when the controllers were last stepped
+    vector<unsigned> stepped;//FleetRegistry::generation when the controllers were last stepped
+    vector<bot_command> stops;
+    double last_t = tic();
+    frame_packet packet;
+    while(detected.pop(packet)){
+      cv::Mat &image = packet.image;
+      cv::Mat &image_gray = packet.image_gray;
+      double t_capture = packet.trace.t[TRACE_CAPTURED];
+      if(!testbed.m_busName.empty() && !bus.isOpened()){//sized by the first frame
+        if(!bus.open(testbed.m_busName,image_gray.cols,image_gray.rows))
+          TLOG_ERROR("can't create the frame bus %s",testbed.m_busName.c_str());
+        testbed.m_busName.clear();
+      }
+      testbed.detections.swap(packet.detections);//only this stage reads the detections of the testbed
+      if(session.isOpened()){
+        session.writeFrame(packet.frame_id,t_capture,image_gray);
+        session.writeDetections(packet.frame_id,testbed.detections);
+      }
+      for(int i = 0;i<bots.size();i++)
+        bots[i].init();
+      int n = testbed.detections.size();
+      slots.resize(n);
+      for(int i = 0;i<n;i++){
+        slots[i] = fleet_registry.add(testbed.detections[i].id,t_capture);//a new tag joins the fleet
+        if(slots[i]<0){
+          if(fleet_registry.count() == fleet_registry.capacity())
+            TLOG_WARN("no free slot for tag %d, already %d robots",testbed.detections[i].id,fleet_registry.count()-1);
+          continue;
+        }
+        bots[slots[i]].plan.robot_id = i;
+        if(testbed.detections[i].id == origin_tag_id){//plane extracted
+          bool moved = testbed.extractPlane(i);
+          if(testbed.m_predictEvery){
+            if(moved)
+              pose_tracker.setPlane(testbed,image_gray.cols,image_gray.rows);
+            if(i<packet.measured)
+              pose_tracker.correct(testbed.detections[i],robot_pose(),t_capture);//keeps the origin's window
+          }
+        }
+      }
+      fleet_registry.retireStale(t_capture);
+      if(bots[0].plan.robot_id<0){
+        poses.clear();
+        bus.publish(packet.frame_id,t_capture,image_gray,testbed.detections,poses);
+        tracer.add(packet.trace);
+        continue;//can't find the origin tag to extract plane
+      }
+      for(int i = 0;i<n;i++){
+        if(slots[i]>0){//robot or goal
+          robot_pose &pose = bots[slots[i]].pose;
+          testbed.findRobotPose(i,pose);//i is the index in detections for which to find pose
+          if(testbed.m_predictEvery){
+            if(i<packet.measured)
+              pose_tracker.correct(testbed.detections[i],pose,t_capture);
+            pose_tracker.predict(testbed.detections[i].id,t_capture,pose);//filtered, or predicted if not detected in this frame
+          }
+        }
+      }
+      packet.trace.mark(TRACE_POSED);
+      if(session.isOpened() || bus.isOpened()){
+        poses.clear();
+        for(int i = 0;i<n;i++){
+          if(slots[i]>0){
+            session_pose p;
+            p.id = testbed.detections[i].id;
+            robot_pose &pose = bots[slots[i]].pose;
+            p.x = pose.x, p.y = pose.y, p.omega = pose.omega;
+            poses.push_back(p);
+          }
+        }
+        session.writePoses(packet.frame_id,poses);
+        bus.publish(packet.frame_id,t_capture,image_gray,testbed.detections,poses);
+      }
 
-    for(int i = 1;i<bots.size();i++){
-      cout<<"planning for id "<<i<<endl;
-      bots[i].plan.BSACoverageIncremental(testbed,bots[i].pose, 2.5,bots);
-    }
+      //all robots must be detected(in frame) when overlay grid is called else some regions on which a robot is 
+      //present(but not detected) would be considered an obstacle
+      //no two robots must be present in the same grid cell(result is undefined)
+      if(first_iter){
+        first_iter = 0;
+        bots[0].plan.overlayGrid(testbed.detections,image_gray);//overlay grid completely reintialize the grid, we have to call it once at the beginning only when all robots first seen simultaneously(the surrounding is assumed to be static) not every iteration
+        for(int i = 1;i<bots.size();i++){
+          bots[i].plan.rcells = bots[0].plan.rcells;
+          bots[i].plan.ccells = bots[0].plan.ccells;
+        }
+      }
+
+      for(int i = 0;i<bots.size();i++){
+        //for bot 0, the origin and robot index would be the same
+        bots[i].plan.origin_id = bots[0].plan.robot_id;//set origin index of every path planner which is the index of tag 0 in detections vector given by RHS
+      }
 
-    //if(!path_planner.total_points){//no path algorithm ever run before, total_points become -1 if no path exists from pos to goal
-      //path_planner.robot_id = tag_id_index_map[robot_id];
-      //path_planner.goal_id = tag_id_index_map[goal_id];
-      //path_planner.origin_id = tag_id_index_map[origin_id];
-      //path_planner.overlayGrid(testbed.detections,image_gray);
-      //if(path_planner.origin_id>=0 && path_planner.robot_id>=0){
-        //path_planner.findCoverageGlobalNeighborPreference(testbed);
-        //path_planner.findCoverageLocalNeighborPreference(testbed,robots[pose_id_index_map[robot_id]]);
-        //path_planner.BSACoverage(testbed,robots[pose_id_index_map[robot_id]]);
-        //if(path_planner.goal_id>=0)
-          //path_planner.findshortest(testbed);
+      fleet_planner.plan(bots,testbed,2.5);
+      packet.trace.mark(TRACE_PLANNED);
+
+      //if(!path_planner.total_points){//no path algorithm ever run before, total_points become -1 if no path exists from pos to goal
+        //path_planner.robot_id = tag_id_index_map[robot_id];
+        //path_planner.goal_id = tag_id_index_map[goal_id];
+        //path_planner.origin_id = tag_id_index_map[origin_id];
+        //path_planner.overlayGrid(testbed.detections,image_gray);
+        //if(path_planner.origin_id>=0 && path_planner.robot_id>=0){
+          //path_planner.findCoverageGlobalNeighborPreference(testbed);
+          //path_planner.findCoverageLocalNeighborPreference(testbed,robots[pose_id_index_map[robot_id]]);
+          //path_planner.BSACoverage(testbed,robots[pose_id_index_map[robot_id]]);
+          //if(path_planner.goal_id>=0)
+            //path_planner.findshortest(testbed);
+        //}
       //}
-    //}
-
-    if(testbed.m_arduino){
-      pair<int,int> wheel_velocities;
-      for(int i = 1;i<bots.size();i++){//0 is for origin
-        wheel_velocities = bots[i].control.computeStimuli(bots[i].pose,bots[i].plan.path_points);//for nonexistent robots, path_points vector would be empty thus preventing the controller to have any effect
-          s_transmit[i-1].print((unsigned char)(bots[i].id));
-          cout<<"sending velocity for bot "<<bots[i].id<<endl;
-          s_transmit[i-1].print((unsigned char)(128+wheel_velocities.first));
-          s_transmit[i-1].print((unsigned char)(128+wheel_velocities.second));
-          cout<<"sent velocities "<<wheel_velocities.first<<" "<<wheel_velocities.second<<endl;
-          //strangely when I send multiple values to different robots in this loop, the robot always move straight irrespective of the value sent
-          //break;
+
+      if(testbed.m_arduino && !control_loop){
+        slot_ids.resize(bots.size());
+        for(int i = 0;i<bots.size();i++)
+          slot_ids[i] = bots[i].id;
+        syncSlots(bots,slot_ids,fleet_registry.generation,stepped_ids,stepped,stops);
+        if(!stops.empty()){
+          if(session.isOpened())
+            session.writeCommands(packet.frame_id,frame_seq,stops);
+          broadcastCommands(s_transmit,stops,frame_seq++,false);
+        }
+        //gather the poses and next targets of all robots and step the controllers in one pass
+        fleet.resize(bots.size());
+        double t_now = tic();
+        for(int i = 1;i<bots.size();i++){//0 is for origin
+          vector<pt> &path = bots[i].plan.path_points;
+          robot_pose pose = bots[i].control.predictPose(bots[i].pose,t_capture,t_now);//where the robot is when the command arrives
+          int next_point = bots[i].control.findNextPoint(pose,path);//for nonexistent robots, path_points vector would be empty thus preventing the controller to have any effect
+          fleet.x[i] = pose.x, fleet.y[i] = pose.y, fleet.omega[i] = pose.omega;
+          if(next_point == path.size())
+            continue;
+          fleet.tx[i] = path[next_point].x, fleet.ty[i] = path[next_point].y;
+          fleet.active[i] = 1;
+        }
+        bots[0].control.computeFleetStimuli(fleet);//all bots share the same controller parameters
+        //all commands go out in a single framed broadcast, every robot picks its own id from it
+        commands.clear();
+        for(int i = 1;i<bots.size();i++){//0 is for origin
+          if(bots[i].id<0)
+            continue;
+          bot_command c;
+          c.id = bots[i].id;
+          c.left = fleet.left[i];
+          c.right = fleet.right[i];
+          commands.push_back(c);
+          TLOG_DEBUG("sending velocities %d %d for bot %d",fleet.left[i],fleet.right[i],bots[i].id);
+          bots[i].control.recordCommand(fleet.left[i],fleet.right[i],t_now);
+          //stamped with the capture time of the frame they were computed from, which keeps the filter's updates in order
+          if(testbed.m_predictEvery)
+            pose_tracker.command(bots[i].id,fleet.left[i],fleet.right[i],t_capture);
+        }
+        if(session.isOpened())
+          session.writeCommands(packet.frame_id,frame_seq,commands);
+        packet.trace.mark(TRACE_ENQUEUED);
+        tracer.add(packet.trace);//before the writer thread can report the frame written
+        broadcastCommands(s_transmit,commands,frame_seq++,true,packet.frame_id);
       }
-    }
-    if(testbed.m_draw){
-      for(int i = 0;i<n;i++){
-        testbed.detections[i].draw(image);
+      else
+        tracer.add(packet.trace);
+      if(control_loop){
+        shared_ptr<fleet_paths> next = make_shared<fleet_paths>();
+        next->paths.resize(bots.size());
+        next->ids.assign(bots.size(),-1);
+        next->generations = fleet_registry.generation;
+        for(int i = 1;i<bots.size();i++){
+          next->paths[i] = bots[i].plan.path_points;
+          next->ids[i] = bots[i].id;
+        }
+        atomic_store(&published_paths,next);
+        for(int i = 0;i<n;i++)
+          if(slots[i]>0)
+            pose_history.add(testbed.detections[i].id,t_capture,bots[slots[i]].pose);
+        vision_frame = packet.frame_id;
       }
-      bots[origin_tag_id].plan.drawGrid(image);
-      for(int i = 1;i<bots.size();i++){
-        bots[i].plan.drawPath(image);
+      if(testbed.m_draw && frame%testbed.m_drawEvery == 0){
+        if(image.empty())//direct V4L2 capture only gives the gray image
+          cv::cvtColor(image_gray,image,CV_GRAY2BGR);
+        overlay.update(bots[0].plan,bots,image.rows,image.cols);
+        overlay.compose(image);
+        for(int i = 0;i<n;i++){
+          testbed.detections[i].draw(image);
+        }
+        //add a next point circle draw for visualisation
+        //add a only shortest path invocation drawing function in pathplanners
+        //correct next point by index to consider reach radius to determine the next point
+        drawn.tryPush(packet);//the display never holds back the control path, frames are dropped instead
+      }
+      // print out the frame rate at which image frames are being processed
+      frame++;
+      if (frame % 10 == 0) {
+        double t = tic();
+        TMETRIC("fps",10./(t-last_t));
+        TMETRIC("latency",t-packet.trace.t[TRACE_CAPTURED]);
+        TLOG_INFO("%.1f fps, frame %ld latency %.3f s, p99 capture to plan %.1f ms",10./(t-last_t),packet.frame_id,
+            t-packet.trace.t[TRACE_CAPTURED],1000*tracer.percentile(TRACE_PLANNED,0.99));
+        if(testbed.m_arduino)
+          TLOG_INFO("p99 capture to command written %.1f ms",1000*tracer.percentile(TRACE_WRITTEN,0.99));
+        if(testbed.m_latestOnly)
+          TLOG_INFO("skipped %lu of %lu camera frames, replaced %lu captured and %lu detected frames",grabber.skipped(),
+              grabber.grabbed(),captured.dropped(),detected.dropped());
+        if(testbed.m_predictEvery)
+          TLOG_INFO("detection: %lu full, %lu windowed, %lu skipped",full_detections.load(),window_detections.load(),skipped_detections.load());
+        for(int i = 0;testbed.m_arduino && i<s_transmit.size();i++){
+          serial_writer_stats st = s_transmit[i].stats();
+          TLOG_INFO("port %d: queue %d sent %lu dropped %lu coalesced %lu",i,st.queue_depth,st.sent,st.dropped,st.coalesced);
+        }
+        last_t = t;
       }
-      //add a next point circle draw for visualisation
-      //add a only shortest path invocation drawing function in pathplanners
-      //correct next point by index to consider reach radius to determine the next point
-      imshow(windowName,image);
-    }
-    // print out the frame rate at which image frames are being processed
-    frame++;
-    if (frame % 10 == 0) {
-      double t = tic();
-      cout << "  " << 10./(t-last_t) << " fps" << endl;
-      last_t = t;
     }
-    if (cv::waitKey(10) == 27){
-      if(testbed.m_arduino){
+    drawn.close();
+    running = false;//nothing left to show, e.g. at the end of a replay
+  });
+
+  thread control_stage;
+  if(control_loop)
+    control_stage = thread([&](){
+      double period = 1/testbed.m_controlRate;
+      double next_tick = tic();
+      long last_frame = -1;
+      shared_ptr<fleet_paths> tick;//the tag ids are read from the plan stage's copy, which registers and retires robots
+      fleet_stimuli tick_fleet;
+      vector<bot_command> tick_commands, tick_stops;
+      vector<int> tick_stepped_ids;
+      vector<unsigned> tick_stepped;
+      while(running){
+        next_tick += period;
+        double wait = next_tick-tic();
+        if(wait>0)
+          this_thread::sleep_for(chrono::microseconds((long)(wait*1e6)));
+        else if(wait<-period)
+          next_tick = tic();//fell behind by more than a tick, don't try to catch up
+        long frame = vision_frame;
+        if(frame<0)
+          continue;//nothing seen yet
+        if(frame != last_frame){
+          tick = atomic_load(&published_paths);
+          syncSlots(bots,tick->ids,tick->generations,tick_stepped_ids,tick_stepped,tick_stops);
+          if(!tick_stops.empty()){//queued ahead of this tick's velocities
+            if(session.isOpened())
+              session.writeCommands(frame,frame_seq,tick_stops);
+            broadcastCommands(s_transmit,tick_stops,frame_seq++,false);
+          }
+        }
+        vector<int> &tick_ids = tick->ids;
+        double t = tic();
+        tick_fleet.resize(bots.size());
         for(int i = 1;i<bots.size();i++){//0 is for origin
-            s_transmit[i-1].print((unsigned char)(bots[i].id));
-            s_transmit[i-1].print((unsigned char)(0));
-            s_transmit[i-1].print((unsigned char)(0));
-            //break;
+          robot_pose pose;
+          if(tick_ids[i]<0 || !pose_history.extrapolate(tick_ids[i],t,pose))
+            continue;//not seen recently, it stops
+          pose = bots[i].control.predictPose(pose,t,t);//only the command latency is left
+          vector<pt> &path = tick->paths[i];
+          int next_point = bots[i].control.findNextPoint(pose,path);
+          tick_fleet.x[i] = pose.x, tick_fleet.y[i] = pose.y, tick_fleet.omega[i] = pose.omega;
+          if(next_point == path.size())
+            continue;
+          tick_fleet.tx[i] = path[next_point].x, tick_fleet.ty[i] = path[next_point].y;
+          tick_fleet.active[i] = 1;
+        }
+        bots[0].control.computeFleetStimuli(tick_fleet);
+        tick_commands.clear();
+        for(int i = 1;i<bots.size();i++){
+          if(tick_ids[i]<0)
+            continue;
+          bot_command c;
+          c.id = tick_ids[i];
+          c.left = tick_fleet.left[i];
+          c.right = tick_fleet.right[i];
+          tick_commands.push_back(c);
+          bots[i].control.recordCommand(tick_fleet.left[i],tick_fleet.right[i],t);
+        }
+        if(session.isOpened())
+          session.writeCommands(frame,frame_seq,tick_commands);
+        if(frame != last_frame)
+          tracer.enqueued(frame);//before the writer thread can report the frame written
+        broadcastCommands(s_transmit,tick_commands,frame_seq++,true,frame);
+        if(frame != last_frame){
+          //one command per frame for the pose filter, stamped with the frame's capture time as in the frame loop
+          for(int i = 1;testbed.m_predictEvery && i<bots.size();i++)
+            if(tick_ids[i]>=0)
+              pose_tracker.command(tick_ids[i],tick_fleet.left[i],tick_fleet.right[i],pose_history.newest());
+          last_frame = frame;
         }
       }
+    });
+
+  frame_packet shown;
+  while(running && !stop_requested){
+    if(!testbed.m_draw){
+      this_thread::sleep_for(chrono::milliseconds(20));//only waits for a signal or the end of a replay
+      continue;
+    }
+    if(drawn.popFor(shown,1))
+      imshow(windowName,shown.image);
+    if (cv::waitKey(10) == 27)
       break;//until escape is pressed
+  }
+  if(stop_requested)
+    TLOG_INFO("signal received, stopping");
+  running = false;
+  grabber.stop();
+  captured.close();
+  detected.close();
+  drawn.close();
+  capture_stage.join();
+  detect_stage.join();
+  plan_stage.join();
+  if(control_stage.joinable())
+    control_stage.join();
+  session.close();//after the stages, which write the last frames, poses and commands up to their end
+  testbed.writeProfile();
+  if(tracer.frames()){
+    tracer.print(cout);
+    if(!testbed.m_latencyPath.empty() && !tracer.write(testbed.m_latencyPath))
+      cerr<<"ERROR: Can't write the latency histograms to "<<testbed.m_latencyPath<<endl;
+  }
+  if(Telemetry::instance().dropped())
+    cerr<<"WARNING: "<<Telemetry::instance().dropped()<<" log records were dropped, the log ring was full"<<endl;
+  if(testbed.m_arduino){
+    commands.clear();
+    for(int id = 0;id<fleet_registry.known.size();id++){//retired robots too, a stop frame may have been missed
+      if(!fleet_registry.known[id])
+        continue;
+      bot_command c;
+      c.id = id;
+      c.left = c.right = 0;
+      commands.push_back(c);
     }
+    broadcastCommands(s_transmit,commands,frame_seq++,false);
+    for(int i = 0;i<s_transmit.size();i++)
+      s_transmit[i].flush();
   }
   return 0;
 }
@@ -10,6 +10,8 @@
 #include <iostream>
 #include <sstream>
 #include <unistd.h>
+#include <poll.h>
+#include <errno.h>
 
 #include "Serial.h"
 
@@ -69,19 +71,21 @@ int Serial::read() const {
 
 // read until special character up to a maximum number of bytes
 string Serial::readBytesUntil(unsigned char until, int max_length) {
-  string result(max_length, ' ');
-  int n = 0;
+  string result;
+  result.reserve(max_length);
+  struct pollfd pfd;
+  pfd.fd = m_serialPort;
+  pfd.events = POLLIN;
   int c;
   do {
     c = read();
-    if (c<0) { // wait for more characters
-      usleep(100);
+    if (c<0) { // sleep until more characters arrive instead of spinning
+      if (poll(&pfd, 1, -1) < 0 && errno != EINTR)
+        break;
     } else {
-      result[n] = (unsigned char)c;
-      n++;
+      result.push_back((unsigned char)c);
     }
-  } while ((c != (int)until) && (n < max_length));
-  result.resize(n);
+  } while ((c != (int)until) && ((int)result.size() < max_length));
   return result;
 }
 
@@ -92,6 +96,10 @@ void Serial::print(string str) const {
 void Serial::print(unsigned char a) const {
     int res = ::write(m_serialPort,&a,1);
 }
+// send a block of bytes with a single write call
+void Serial::write(const unsigned char* buf, int len) const {
+  int res = ::write(m_serialPort, buf, len);
+}
 // send an integer
 void Serial::print(int num) const {
   stringstream stream;
@@ -0,0 +1,78 @@
+#include "anchors.h"
+#include <cmath>
+using namespace std;
+
+void AnchorRegistry::addStatic(int id){
+  if(id<0)
+    return;
+  if(id>=(int)m_anchors.size())
+    m_anchors.resize(id+1);
+  m_anchors[id].is_static = true;
+  m_anchors[id].restart();
+}
+
+bool AnchorRegistry::isStatic(int id) const{
+  return id>=0 && id<(int)m_anchors.size() && m_anchors[id].is_static;
+}
+
+bool AnchorRegistry::locked(int id) const{
+  return isStatic(id) && m_anchors[id].locked;
+}
+
+void AnchorRegistry::solve(const AprilTags::TagDetection &det, double tag_size, double fx, double fy, double px, double py, anchor_plane &plane){
+  Eigen::Vector3d translation;
+  Eigen::Matrix3d rotation;
+  det.getRelativeTranslationRotation(tag_size,fx,fy,px,py,translation,rotation);
+  plane.origin = translation;//the tag centre
+  plane.x_axis = rotation.col(0);
+  plane.y_axis = rotation.col(1);
+}
+
+static double cornerDrift(const AprilTags::TagDetection &det, const pair<float,float> corners[4]){
+  double d = 0;
+  for(int k = 0;k<4;k++)
+    d = max(d,(double)hypot(det.p[k].first-corners[k].first,det.p[k].second-corners[k].second));
+  return d;
+}
+
+bool AnchorRegistry::plane(const AprilTags::TagDetection &det, double tag_size, double fx, double fy, double px, double py, anchor_plane &plane){
+  if(!isStatic(det.id)){
+    solve(det,tag_size,fx,fy,px,py,plane);
+    return true;
+  }
+  anchor &a = m_anchors[det.id];
+  if(a.seen && cornerDrift(det,a.corners)>drift)
+    a.restart();//moved, while locked or while the average was still being built
+  if(a.locked){
+    plane = a.sum;
+    return false;
+  }
+  solve(det,tag_size,fx,fy,px,py,plane);
+  if(!a.seen){
+    a.sum.origin.setZero();
+    a.sum.x_axis.setZero();
+    a.sum.y_axis.setZero();
+  }
+  a.seen++;
+  a.sum.origin += plane.origin;
+  a.sum.x_axis += plane.x_axis;
+  a.sum.y_axis += plane.y_axis;
+  for(int k = 0;k<4;k++){
+    if(a.seen == 1)
+      a.corners[k] = det.p[k];
+    else{
+      a.corners[k].first += (det.p[k].first-a.corners[k].first)/a.seen;
+      a.corners[k].second += (det.p[k].second-a.corners[k].second)/a.seen;
+    }
+  }
+  //the mean so far, with the axes made orthonormal again
+  plane.origin = a.sum.origin/a.seen;
+  plane.x_axis = a.sum.x_axis.normalized();
+  plane.y_axis = a.sum.y_axis-a.sum.y_axis.dot(plane.x_axis)*plane.x_axis;
+  plane.y_axis.normalize();
+  if(a.seen>=lock_frames){
+    a.sum = plane;
+    a.locked = true;
+  }
+  return true;
+}
@@ -14,10 +14,37 @@ const string usage = "\n"
   "Options:\n"
   "  -h  -?          Show help options\n"
   "  -a              Arduino (send tag ids over serial port)\n"
-  "  -d              Disable graphics\n"
-  "  -t              Timing of tag extraction\n"
+  "  -d              Disable graphics, runs headless without a display until SIGINT or SIGTERM\n"
+  "  -I <frames>     Draw and show only every <frames>th frame (default 1), the rest go straight to control\n"
+  "  -t              Timing of tag extraction stages (p50/p99 summary every 100 frames)\n"
+  "  -T <file>       Export the tag extraction timings on exit (.json for json, csv otherwise)\n"
+  "  -L              Only process the newest camera frame, skipping the ones buffered meanwhile\n"
   "  -C <bbxhh>      Tag family (default 36h11)\n"
   "  -D <id>         Video device ID (if multiple cameras present)\n"
+  "  -V <path>       Capture directly from a V4L2 device, or replay a file of raw YUYV frames\n"
+  "  -N <buffers>    Number of V4L2 capture buffers (default 4)\n"
+  "  -R <file>       Record frames, detections, poses and commands to a session log\n"
+  "  -Z              Compress the recorded frames (png)\n"
+  "  -P <file>       Replay the frames of a session log at full speed instead of using a camera\n"
+  "  -O <file>       Write log messages and metrics to a file instead of stdout\n"
+  "  -Y <file>       Export the capture to wheel command latency histograms on exit (csv)\n"
+  "  -K <frames>     Track the robots with a pose filter, detecting only around the predicted poses (and on\n"
+  "                  every other frame while the predictions are trusted) with a full detection every <frames>\n"
+  "  -U <scale>      World units per second of one wheel velocity unit, lets the pose filter use the commands\n"
+  "  -Q <hz>         Run the controllers in a thread of their own at this rate (e.g. 100), on poses\n"
+  "                  extrapolated to the present, instead of once per camera frame\n"
+  "  -J <seconds>    Latency from computing a command to the robot acting on it, with -U the controllers\n"
+  "                  move every pose forward by its age plus this latency using the commands already sent\n"
+  "  -X <robots>     Most robots in play at once (default 32, up to 255), they join when their tag is first\n"
+  "                  seen and leave when it has not been seen for 5 s\n"
+  "  -j <threads>    Plan the robots' paths on this many threads (default 1, 0 for one per core), the robots\n"
+  "                  then take cells of the shared map in rounds, the lowest tag id wins a contested cell\n"
+  "  -w <points>     Plan this many spiral points ahead of every robot, assuming it gets to its target, so\n"
+  "                  that it keeps moving between frames instead of stopping at every cell (default 1)\n"
+  "  -A <n>[,<px>]   Lock the plane of the origin tag once averaged over <n> frames, solving it again only\n"
+  "                  when its corners move more than <px> pixels (default 2)\n"
+  "  -M <name>       Publish the frames, detections and poses on a shared memory bus for other processes\n"
+  "                  such as busview, \"-\" for " FRAMEBUS_DEFAULT_NAME "\n"
   "  -F <fx>         Focal length in pixels\n"
   "  -W <width>      Image width (default 640, availability depends on camera)\n"
   "  -H <height>     Image height (default 480, availability depends on camera)\n"
@@ -115,7 +142,7 @@ void AprilInterfaceAndVideoCapture::setTagCodes(string s) {
 // parse command line options to change default behavior
 void AprilInterfaceAndVideoCapture::parseOptions(int argc, char* argv[]) {
   int c;
-  while ((c = getopt(argc, argv, ":h?adtC:F:H:S:W:E:G:B:D:")) != -1) {
+  while ((c = getopt(argc, argv, ":h?adtLC:F:H:S:W:E:G:B:D:V:N:R:ZP:T:O:Y:K:U:Q:J:M:I:A:X:j:w:")) != -1) {
     // Each option character has to be in the string in getopt();
     // the first colon changes the error character from '?' to ':';
     // a colon after an option means that there is an extra
@@ -136,6 +163,13 @@ void AprilInterfaceAndVideoCapture::parseOptions(int argc, char* argv[]) {
     case 't':
       m_timing = true;
       break;
+    case 'T':
+      m_timing = true;
+      m_profilePath = optarg;
+      break;
+    case 'L':
+      m_latestOnly = true;
+      break;
     case 'C':
       setTagCodes(optarg);
       break;
@@ -178,6 +212,58 @@ void AprilInterfaceAndVideoCapture::parseOptions(int argc, char* argv[]) {
     case 'D':
       m_deviceId = atoi(optarg);
       break;
+    case 'V':
+      m_v4l2Path = optarg;
+      break;
+    case 'N':
+      m_v4l2Buffers = atoi(optarg);
+      break;
+    case 'R':
+      m_recordPath = optarg;
+      break;
+    case 'Z':
+      m_compressRecord = true;
+      break;
+    case 'P':
+      m_replayPath = optarg;
+      break;
+    case 'O':
+      m_logPath = optarg;
+      break;
+    case 'Y':
+      m_latencyPath = optarg;
+      break;
+    case 'K':
+      m_predictEvery = atoi(optarg);
+      break;
+    case 'U':
+      m_velocityScale = atof(optarg);
+      break;
+    case 'Q':
+      m_controlRate = atof(optarg);
+      break;
+    case 'J':
+      m_commandLatency = atof(optarg);
+      break;
+    case 'I':
+      m_drawEvery = max(1,atoi(optarg));
+      break;
+    case 'X':
+      m_maxRobots = min(max(1,atoi(optarg)),FRAME_MAX_COMMANDS);
+      break;
+    case 'j':
+      m_planThreads = max(0,atoi(optarg));
+      break;
+    case 'w':
+      m_lookahead = max(1,atoi(optarg));
+      break;
+    case 'A':
+      sscanf(optarg,"%d,%lf",&m_anchorFrames,&m_anchors.drift);
+      m_anchors.lock_frames = m_anchorFrames;
+      break;
+    case 'M':
+      m_busName = strcmp(optarg,"-") ? optarg : FRAMEBUS_DEFAULT_NAME;
+      break;
     case ':': // unknown option, from getopt
       cout << intro;
       cout << usage;
@@ -194,10 +280,22 @@ void AprilInterfaceAndVideoCapture::parseOptions(int argc, char* argv[]) {
 }
 
 void AprilInterfaceAndVideoCapture::setup(){
+  if (!m_logPath.empty() && !Telemetry::instance().open(m_logPath)) {
+    cerr << "ERROR: Can't write the log to " << m_logPath << "\n";
+    exit(1);
+  }
   m_tagDetector = new AprilTags::TagDetector(m_tagCodes);
 }
 
 void AprilInterfaceAndVideoCapture::setupVideo(){
+  if (!m_replayPath.empty()) {
+    if (!m_replay.open(m_replayPath)) {
+      cerr << "ERROR: Can't replay session " << m_replayPath << "\n";
+      exit(1);
+    }
+    cout << "Replaying session " << m_replayPath << endl;
+    return;
+  }
 #ifdef EXPOSURE_CONTROL
   // manually setting camera exposure settings; OpenCV/v4l1 doesn't
   // support exposure control; so here we manually use v4l2 before
@@ -205,6 +303,8 @@ void AprilInterfaceAndVideoCapture::setupVideo(){
   // C270; try exposure=20, gain=100, brightness=150
   string video_str = "/dev/video0";
   video_str[10] = '0' + m_deviceId;
+  if (!m_v4l2Path.empty())
+    video_str = m_v4l2Path;
   int device = v4l2_open(video_str.c_str(), O_RDWR | O_NONBLOCK);
 
   if (m_exposure >= 0) {
@@ -230,6 +330,17 @@ void AprilInterfaceAndVideoCapture::setupVideo(){
   v4l2_close(device);
 #endif 
 
+  if (!m_v4l2Path.empty()) {
+    if (!m_v4l2.open(m_v4l2Path, m_width, m_height, m_v4l2Buffers)) {
+      cerr << "ERROR: Can't capture from " << m_v4l2Path << "\n";
+      exit(1);
+    }
+    m_px = m_width/2;
+    m_py = m_height/2;
+    cout << "Capturing directly from " << m_v4l2Path << " with " << m_v4l2.bufferCount() << " buffers" << endl;
+    cout << "Actual resolution: " << m_width << "x" << m_height << endl;
+    return;
+  }
   // find and open a USB camera (built in laptop camera, web cam etc)
   m_cap = cv::VideoCapture(m_deviceId);
       if(!m_cap.isOpened()) {
@@ -269,20 +380,14 @@ void AprilInterfaceAndVideoCapture::findNormal(Eigen::Vector3d &trans, Eigen::Ma
   result = xcoord.cross(ycoord);
 }
 
-void AprilInterfaceAndVideoCapture::extractPlane(int ind){
-  Eigen::Vector3d translation;
-  Eigen::Matrix3d rotation;
-  detections[ind].getRelativeTranslationRotation(m_tagSize, m_fx, m_fy, m_px, m_py,translation, rotation);
-  Eigen::Vector3d ori(0,0,0);
-  Eigen::Vector3d xone(1,0,0);
-  Eigen::Vector3d yone(0,1,0);
-  planeOrigin = (rotation*ori) + translation;
-  x_axis = (rotation*xone) + translation;
-  x_axis = x_axis - planeOrigin;
-  x_axis.normalize();//this step is important
-  y_axis = (rotation*yone) + translation;
-  y_axis = y_axis - planeOrigin;
-  y_axis.normalize();
+bool AprilInterfaceAndVideoCapture::extractPlane(int ind){
+  anchor_plane plane;
+  if(!m_anchors.plane(detections[ind],m_tagSize,m_fx,m_fy,m_px,m_py,plane))
+    return false;//locked, the plane is the one already set
+  planeOrigin = plane.origin;
+  x_axis = plane.x_axis;//unit vectors, this is important
+  y_axis = plane.y_axis;
+  return true;
 }
 
 //robot is assumed to be facing positive y direction of it's apriltag
@@ -303,24 +408,74 @@ void AprilInterfaceAndVideoCapture::findRobotPose(int ind, robot_pose &rob){
   rob.omega = atan2(tempy,tempx);
 }
 
+bool AprilInterfaceAndVideoCapture::grabFrame(cv::Mat& image, cv::Mat& image_gray, double &t_capture) {
+  if (m_replay.isOpened()) {
+    long frame_id;
+    image.release();
+    return m_replay.nextFrame(image_gray, frame_id, t_capture);
+  }
+  if (m_v4l2.isOpened()) {
+    image.release();
+    return m_v4l2.grab(image_gray, t_capture);
+  }
+  bool ok = m_cap.read(image);
+  t_capture = tic();
+  return ok;
+}
+
 void AprilInterfaceAndVideoCapture::processImage(cv::Mat& image, cv::Mat& image_gray) {
+  detectTags(image, image_gray, detections);
+}
+
+void AprilInterfaceAndVideoCapture::detectTags(cv::Mat& image, cv::Mat& image_gray, vector<AprilTags::TagDetection> &dets) {
   // alternative way is to grab, then retrieve; allows for
   // multiple grab when processing below frame rate - v4l keeps a
   // number of frames buffered, which can lead to significant lag
   //      m_cap.grab();
   //      m_cap.retrieve(image);
   // detect April tags (requires a gray scale image)
-  cv::cvtColor(image, image_gray, CV_BGR2GRAY);
-  double t0;
+  if (!image.empty())
+    cv::cvtColor(image, image_gray, CV_BGR2GRAY);
+  dets = m_tagDetector->extractTags(image_gray);
   if (m_timing) {
-    t0 = tic();
+    m_profiler.add(m_tagDetector->stats);
+    if (m_profiler.frames() % m_profileEvery == 0)
+      m_profiler.print(cout);
   }
-  detections = m_tagDetector->extractTags(image_gray);
-  if (m_timing) {
-    double dt = tic()-t0;
-    cout << "Extracting tags took " << dt << " seconds." << endl;
+  TLOG_DEBUG("%d tags detected", (int)dets.size());
+}
+
+void AprilInterfaceAndVideoCapture::detectTagsInWindows(cv::Mat& image, cv::Mat& image_gray, const vector<cv::Rect> &windows, vector<AprilTags::TagDetection> &dets) {
+  if (!image.empty())
+    cv::cvtColor(image, image_gray, CV_BGR2GRAY);
+  dets.clear();
+  for (int w = 0; w < windows.size(); w++) {
+    const cv::Rect &r = windows[w];
+    cv::Mat roi = image_gray(r).clone(); // the detector reads the pixels as one contiguous block
+    vector<AprilTags::TagDetection> found = m_tagDetector->extractTags(roi);
+    for (int i = 0; i < found.size(); i++) {
+      AprilTags::TagDetection &d = found[i];
+      for (int k = 0; k < 4; k++) {
+        d.p[k].first += r.x;
+        d.p[k].second += r.y;
+      }
+      d.cxy.first += r.x;
+      d.cxy.second += r.y;
+      d.hxy.first += r.x; // the homography is relative to hxy
+      d.hxy.second += r.y;
+      dets.push_back(d);
+    }
   }
-  cout << detections.size() << " tags detected:" << endl;
+  TLOG_DEBUG("%d tags detected in %d windows", (int)dets.size(), (int)windows.size());
+}
+
+void AprilInterfaceAndVideoCapture::writeProfile() {
+  if (m_profilePath.empty() || !m_profiler.frames())
+    return;
+  if (m_profiler.write(m_profilePath))
+    cout << "Detector profile written to " << m_profilePath << endl;
+  else
+    cerr << "ERROR: Can't write detector profile to " << m_profilePath << endl;
 }
 
 // Load and process a single image
@@ -1,8 +1,6 @@
 #include "controllers.h"
-#include <Eigen/Geometry>
 #include <cmath>
 using namespace std;
-using namespace Eigen;
 
 void PurePursuitController::calculateMinimumTurnRadius(){//finds turn radius in axle length scale
   min_turn_radius = (axle_length*(linear_velocity+max_velocity))/(2*(max_velocity-linear_velocity));
@@ -46,30 +44,25 @@ int PurePursuitController::findNextPointByPathIndex(robot_pose &rp, vector<pt> &
   return next_index;
 }
 
-pair<int,int> PurePursuitController::computeStimuli(robot_pose &rp,vector<pt> &path){
-  int next_point;
+int PurePursuitController::findNextPoint(robot_pose &rp, vector<pt> &path){
   if(next_point_by_pursuit)
-    next_point = findNextPointByPursuit(rp,path);
-  else
-    next_point = findNextPointByPathIndex(rp,path);
-  if(next_point == path.size())
-    return make_pair(0,0);
-  Vector2d vec_translate(path[next_point].x-rp.x, path[next_point].y-rp.y);
-  Rotation2D<double> rot(-(rp.omega-PI/2.0));
-  Vector2d robot_relative_coords = rot*vec_translate;
-  if(abs(robot_relative_coords(0))<eps)
+    return findNextPointByPursuit(rp,path);
+  return findNextPointByPathIndex(rp,path);
+}
+
+pair<int,int> PurePursuitController::stimuliFromRelative(double rel_x, double rel_y, double dist_sq){
+  if(abs(rel_x)<eps && rel_y>=0)//a target exactly behind still needs the in place turn below
     return make_pair(linear_velocity,linear_velocity);
   int flag_turn_left = 0;
-  if(robot_relative_coords(0)<0){//2 quadrants to consider now
+  if(rel_x<0){//2 quadrants to consider now
     flag_turn_left = 1;
-    robot_relative_coords(0) *= -1;
+    rel_x *= -1;
   }
-  if(robot_relative_coords(1)<0){
+  if(rel_y<0){
     if(flag_turn_left) return make_pair((-1)*inplace_turn_velocity,inplace_turn_velocity);
     else return make_pair(inplace_turn_velocity,(-1)*inplace_turn_velocity);
   }
-  double distance_to_next = distance(rp.x,rp.y,path[next_point].x,path[next_point].y);
-  double radius_of_curvature = pow(distance_to_next,2)/(2.0*robot_relative_coords(0));
+  double radius_of_curvature = dist_sq/(2.0*rel_x);
   if(radius_of_curvature<min_turn_radius){
     if(flag_turn_left) return make_pair((-1)*inplace_turn_velocity,inplace_turn_velocity);
     else return make_pair(inplace_turn_velocity,(-1)*inplace_turn_velocity);
@@ -79,3 +72,101 @@ pair<int,int> PurePursuitController::computeStimuli(robot_pose &rp,vector<pt> &p
   else return make_pair(linear_velocity+excess_turn,linear_velocity);
 }
 
+pair<int,int> PurePursuitController::computeStimuli(robot_pose &rp,vector<pt> &path){
+  int next_point = findNextPoint(rp,path);
+  if(next_point == path.size())
+    return make_pair(0,0);
+  double dx = path[next_point].x-rp.x, dy = path[next_point].y-rp.y;
+  //rotating by -(omega-pi/2) brings the robot heading along positive y
+  double s = sin(rp.omega), c = cos(rp.omega);
+  return stimuliFromRelative(s*dx-c*dy, c*dx+s*dy, dx*dx+dy*dy);
+}
+
+void fleet_stimuli::resize(int n){
+  x.resize(n); y.resize(n); omega.resize(n);
+  tx.resize(n); ty.resize(n);
+  active.assign(n,0);
+  rel_x.resize(n); rel_y.resize(n); dist_sq.resize(n);
+  left.resize(n); right.resize(n);
+}
+
+pair<int,int> PurePursuitController::computeStimuli(robot_pose &rp,vector<pt> &path, double t_pose, double t_now){
+  robot_pose ahead = predictPose(rp,t_pose,t_now);
+  pair<int,int> wheel_velocities = computeStimuli(ahead,path);
+  recordCommand(wheel_velocities.first,wheel_velocities.second,t_now);
+  return wheel_velocities;
+}
+
+robot_pose PurePursuitController::predictPose(const robot_pose &rp, double t_pose, double t_now){
+  robot_pose p = rp;
+  if(velocity_scale<=0)
+    return p;
+  double t = t_pose, t_end = t_now+latency;
+  int left = 0, right = 0;//stopped if nothing was sent before the pose was taken
+  for(int i = 0;i<issued.size();i++){
+    double t_act = issued[i].t+latency;
+    if(t_act>=t_end)
+      break;
+    if(t_act>t){
+      integrateUnicycle(p,left,right,axle_length,velocity_scale,t_act-t);
+      t = t_act;
+    }
+    left = issued[i].left;
+    right = issued[i].right;
+  }
+  if(t_end>t)
+    integrateUnicycle(p,left,right,axle_length,velocity_scale,t_end-t);
+  return p;
+}
+
+void PurePursuitController::recordCommand(int left, int right, double t){
+  if(velocity_scale<=0)
+    return;
+  issued.push_back(timed_command(t,left,right));
+  //poses are never more than a second old, the newest command acting before that is still needed
+  while(issued.size()>1 && (issued[1].t+latency<t-1 || issued.size()>256))
+    issued.pop_front();
+}
+
+void PurePursuitController::reset(){
+  issued.clear();
+  next_index = 0;
+}
+
+void PurePursuitController::computeFleetStimuli(fleet_stimuli &fs){
+  int n = fs.size();
+  //first pass is branch free so that the compiler can vectorize it over all robots
+  const double *x = fs.x.data(), *y = fs.y.data(), *omega = fs.omega.data();
+  const double *tx = fs.tx.data(), *ty = fs.ty.data();
+  double *rel_x = fs.rel_x.data(), *rel_y = fs.rel_y.data(), *dist_sq = fs.dist_sq.data();
+  for(int i = 0;i<n;i++){
+    double dx = tx[i]-x[i], dy = ty[i]-y[i];
+    double s = sin(omega[i]), c = cos(omega[i]);
+    rel_x[i] = s*dx-c*dy;
+    rel_y[i] = c*dx+s*dy;
+    dist_sq[i] = dx*dx+dy*dy;
+  }
+  for(int i = 0;i<n;i++){
+    if(!fs.active[i]){
+      fs.left[i] = fs.right[i] = 0;
+      continue;
+    }
+    pair<int,int> wheel_velocities = stimuliFromRelative(rel_x[i],rel_y[i],dist_sq[i]);
+    fs.left[i] = wheel_velocities.first;
+    fs.right[i] = wheel_velocities.second;
+  }
+}
+
+void integrateUnicycle(robot_pose &rp, int left, int right, double axle_length, double velocity_scale, double dt){
+  double v = velocity_scale*(left+right)/2.0;
+  double w = velocity_scale*(right-left)/axle_length;//right wheel faster turns towards positive omega, as computeStimuli assumes
+  if(abs(w*dt)<1e-9){
+    rp.x += v*dt*cos(rp.omega);
+    rp.y += v*dt*sin(rp.omega);
+    return;
+  }
+  double omega = rp.omega+w*dt;
+  rp.x += v/w*(sin(omega)-sin(rp.omega));
+  rp.y -= v/w*(cos(omega)-cos(rp.omega));
+  rp.omega = atan2(sin(omega),cos(omega));//back into [-pi,pi]
+}
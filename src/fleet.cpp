@@ -0,0 +1,187 @@
+#include "fleet.h"
+#include <thread>
+using namespace std;
+
+FleetRegistry::FleetRegistry(int capacity, const bot_config &proto):retire_after(5),m_count(0),m_used(0),m_proto(proto){
+  m_proto.plan.rcells = m_proto.plan.ccells = 0;
+  bots.assign(capacity,m_proto);
+  last_seen.assign(capacity,0);
+  pinned.assign(capacity,0);
+  generation.assign(capacity,0);
+  known.assign(FRAME_MAX_ID+1,0);
+  for(int s = capacity-1;s>=0;s--){
+    bots[s].id = -1;
+    m_free.push_back(s);
+  }
+  int buckets = 8;
+  while(buckets<2*capacity)//at most half full with every slot taken
+    buckets *= 2;
+  m_keys.assign(buckets,(int)EMPTY);
+  m_slots.assign(buckets,-1);
+}
+
+static unsigned hashId(int tag_id){
+  unsigned h = (unsigned)tag_id*2654435769u;//fibonacci hashing, spreads consecutive ids
+  return h^(h>>16);
+}
+
+int FleetRegistry::bucket(int tag_id) const{
+  int mask = m_keys.size()-1;
+  for(int b = hashId(tag_id)&mask;;b = (b+1)&mask)//linear probing, there is always an empty bucket
+    if(m_keys[b] == tag_id || m_keys[b] == EMPTY)
+      return b;
+}
+
+int FleetRegistry::slot(int tag_id) const{
+  if(tag_id<0)
+    return -1;
+  int b = bucket(tag_id);
+  return m_keys[b] == tag_id ? m_slots[b] : -1;
+}
+
+void FleetRegistry::rehash(){
+  vector<int> keys(m_keys.size(),(int)EMPTY);
+  keys.swap(m_keys);
+  vector<int> slots(m_slots.size(),-1);
+  slots.swap(m_slots);
+  m_used = 0;
+  for(int i = 0;i<keys.size();i++){
+    if(keys[i]<0)
+      continue;
+    int b = bucket(keys[i]);
+    m_keys[b] = keys[i];
+    m_slots[b] = slots[i];
+    m_used++;
+  }
+}
+
+int FleetRegistry::add(int tag_id, double t, bool pin){
+  if(tag_id<0)
+    return -1;
+  if(tag_id>FRAME_MAX_ID){//would get the commands of tag_id%256
+    TLOG_WARN("tag %d can't be a robot, command frames carry ids up to %d",tag_id,FRAME_MAX_ID);
+    return -1;
+  }
+  int s = slot(tag_id);
+  if(s<0){
+    if(m_free.empty())
+      return -1;
+    if(4*(m_used+1)>3*(int)m_keys.size())//the tombstones of retired robots lengthen every probe
+      rehash();
+    s = m_free.back();
+    m_free.pop_back();
+    int b = bucket(tag_id);
+    m_keys[b] = tag_id;
+    m_slots[b] = s;
+    m_used++;
+    m_count++;
+    bot_config &bot = bots[s];
+    bot.id = tag_id;
+    bot.plan.robot_tag_id = tag_id;
+    bot.plan.path_color = cv::Scalar(PathPlannerGrid::rng.uniform(0,255),PathPlannerGrid::rng.uniform(0,255),PathPlannerGrid::rng.uniform(0,255));
+    pinned[s] = pin;
+    generation[s]++;
+    if(!pin)
+      known[tag_id] = 1;
+  }
+  last_seen[s] = t;
+  return s;
+}
+
+void FleetRegistry::retire(int s){
+  if(s<0 || s>=bots.size() || bots[s].id<0)
+    return;
+  int b = bucket(bots[s].id);
+  m_keys[b] = TOMBSTONE;//keeps the probe sequences running through it intact
+  m_slots[b] = -1;
+  m_count--;
+  bot_config &bot = bots[s];
+  int rcells = bot.plan.rcells, ccells = bot.plan.ccells;//the size of the shared map, not the robot's
+  bot.plan = m_proto.plan;
+  bot.plan.rcells = rcells, bot.plan.ccells = ccells;
+  bot.pose = robot_pose();
+  bot.id = -1;
+  pinned[s] = 0;
+  generation[s]++;
+  m_free.push_back(s);
+}
+
+int FleetRegistry::retireStale(double t){
+  int retired = 0;
+  for(int s = 0;s<bots.size();s++){
+    if(bots[s].id<0 || pinned[s] || t-last_seen[s]<=retire_after)
+      continue;
+    retire(s);
+    retired++;
+  }
+  return retired;
+}
+
+void FleetPlanner::plan(vector<bot_config> &bots, WorldMapping &testbed, double reach_distance){
+  int n = threads>0 ? threads : max(1,(int)thread::hardware_concurrency());
+  if(n == 1){
+    for(int i = 1;i<bots.size();i++){
+      if(bots[i].plan.robot_id<0)
+        continue;//free, or not in this frame
+      TLOG_DEBUG("planning for id %d",bots[i].id);
+      bots[i].plan.BSACoverageIncremental(testbed,bots[i].pose,reach_distance,bots);
+    }
+    return;
+  }
+  m_workers.resize(n);
+  PathPlannerGrid &map = bots[0].plan;
+  m_claims.reset(map.world_grid,map.rcells,map.ccells);
+  m_moves.assign(bots.size(),bsa_move());
+  m_won.assign(bots.size(),0);
+  m_pending.clear();
+  for(int i = 1;i<bots.size();i++){
+    bots[i].plan.claims = &m_claims;
+    bots[i].plan.workers = &m_workers;
+    if(bots[i].plan.robot_id<0)
+      continue;
+    if(bots[i].plan.first_call)//only takes the cell the robot is on, before anyone else can
+      bots[i].plan.BSACoverageIncremental(testbed,bots[i].pose,reach_distance,bots);
+    else
+      m_pending.push_back(i);
+  }
+  while(!m_pending.empty()){
+    m_workers.run(m_pending.size(),[&](int k){
+      int i = m_pending[k];
+      bsa_move &move = m_moves[i];
+      move = bots[i].plan.BSAProposeIncremental(testbed,bots[i].pose,reach_distance);
+      if(move.kind == BSA_CLAIM)
+        m_claims.bid(move.cell.first,move.cell.second,bots[i].plan.robot_tag_id);
+    });
+    m_workers.run(m_pending.size(),[&](int k){
+      int i = m_pending[k];
+      bsa_move &move = m_moves[i];
+      int id = bots[i].plan.robot_tag_id;
+      m_won[i] = move.kind == BSA_CLAIM && m_claims.winner(move.cell.first,move.cell.second) == id &&
+        m_claims.claim(move.cell.first,move.cell.second,id);
+      if(m_won[i])
+        bots[i].plan.BSACommitIncremental(move,testbed,bots[i].pose);
+    });
+    //only once every cell of the round is taken, so that the backtracking points found don't depend on the timing
+    m_workers.run(m_pending.size(),[&](int k){
+      int i = m_pending[k];
+      if(m_won[i])
+        bots[i].plan.BSAAddBacktrackPoints();
+    });
+    m_next.clear();
+    for(int k = 0;k<m_pending.size();k++){
+      int i = m_pending[k];
+      if(m_moves[i].kind != BSA_CLAIM)
+        continue;
+      m_claims.clearBid(m_moves[i].cell.first,m_moves[i].cell.second);
+      if(!m_won[i])
+        m_next.push_back(i);//outbid, tries its next cell
+      else if(bots[i].plan.lookahead>1)
+        m_next.push_back(i);//plans the cell after, up to lookahead ahead of the robot
+    }
+    m_pending.swap(m_next);
+  }
+  //the return phase reads and reorders the backtracking points of every robot, so it runs alone, in slot order
+  for(int i = 1;i<bots.size();i++)
+    if(bots[i].plan.robot_id>=0 && m_moves[i].kind == BSA_BACKTRACK)
+      bots[i].plan.BSABacktrackIncremental(testbed,bots);
+}
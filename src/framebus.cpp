@@ -0,0 +1,164 @@
+#include "framebus.h"
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+using namespace std;
+
+static size_t slotBytes(int width, int height){
+  size_t bytes = sizeof(framebus_slot)+(size_t)width*height;
+  return (bytes+63)/64*64;//slots start on their own cache line
+}
+
+static framebus_slot* slotAt(const framebus_header *h, uint64_t index){
+  unsigned char *base = (unsigned char*)h+(sizeof(framebus_header)+63)/64*64;
+  return (framebus_slot*)(base+(index%h->slots)*h->slot_bytes);
+}
+
+FrameBusWriter::FrameBusWriter():m_header(NULL),m_size(0){}
+
+FrameBusWriter::~FrameBusWriter(){
+  close();
+}
+
+bool FrameBusWriter::open(const string &name, int width, int height, int slots){
+  close();
+  shm_unlink(name.c_str());//a bus left behind by a crashed run
+  int fd = shm_open(name.c_str(),O_CREAT | O_EXCL | O_RDWR,0644);
+  if(fd<0)
+    return false;
+  size_t size = (sizeof(framebus_header)+63)/64*64+slots*slotBytes(width,height);
+  if(ftruncate(fd,size) != 0){
+    ::close(fd);
+    shm_unlink(name.c_str());
+    return false;
+  }
+  void *data = mmap(NULL,size,PROT_READ | PROT_WRITE,MAP_SHARED,fd,0);
+  ::close(fd);
+  if(data == MAP_FAILED){
+    shm_unlink(name.c_str());
+    return false;
+  }
+  //ftruncate zero fills, so every sequence starts even and nothing is published
+  m_header = (framebus_header*)data;
+  m_header->slots = slots;
+  m_header->width = width;
+  m_header->height = height;
+  m_header->slot_bytes = slotBytes(width,height);
+  m_header->published.store(0,memory_order_relaxed);
+  atomic_thread_fence(memory_order_release);
+  m_header->magic = FRAMEBUS_MAGIC;//readers refuse the segment until it is set up
+  m_size = size;
+  m_name = name;
+  return true;
+}
+
+void FrameBusWriter::close(){
+  if(!m_header)
+    return;
+  munmap(m_header,m_size);
+  shm_unlink(m_name.c_str());
+  m_header = NULL;
+  m_size = 0;
+}
+
+void FrameBusWriter::publish(long frame_id, double t_capture, const cv::Mat &gray,
+    const vector<AprilTags::TagDetection> &dets, const vector<session_pose> &poses){
+  if(!m_header)
+    return;
+  uint64_t n = m_header->published.load(memory_order_relaxed);
+  framebus_slot *slot = slotAt(m_header,n);
+  uint64_t seq = slot->seq.load(memory_order_relaxed);
+  slot->seq.store(seq+1,memory_order_relaxed);
+  atomic_thread_fence(memory_order_release);//readers see the odd sequence before any of the new data
+  slot->frame_id = frame_id;
+  slot->t_capture = t_capture;
+  bool fits = gray.cols<=(int)m_header->width && gray.rows<=(int)m_header->height && gray.type() == CV_8UC1;
+  slot->rows = fits ? gray.rows : 0;
+  slot->cols = fits ? gray.cols : 0;
+  for(int r = 0;r<slot->rows;r++)
+    memcpy(slot->pixels()+r*gray.cols,gray.ptr(r),gray.cols);
+  slot->n_detections = min((int)dets.size(),FRAMEBUS_MAX_TAGS);
+  for(int i = 0;i<slot->n_detections;i++)
+    packDetection(dets[i],slot->detections[i]);
+  slot->n_poses = min((int)poses.size(),FRAMEBUS_MAX_TAGS);
+  memcpy(slot->poses,poses.data(),slot->n_poses*sizeof(session_pose));
+  slot->seq.store(seq+2,memory_order_release);
+  m_header->published.store(n+1,memory_order_release);
+}
+
+FrameBusReader::FrameBusReader():m_header(NULL),m_size(0){}
+
+FrameBusReader::~FrameBusReader(){
+  close();
+}
+
+bool FrameBusReader::open(const string &name){
+  close();
+  int fd = shm_open(name.c_str(),O_RDONLY,0);
+  if(fd<0)
+    return false;
+  struct stat st;
+  if(fstat(fd,&st) != 0 || st.st_size < (off_t)sizeof(framebus_header)){
+    ::close(fd);
+    return false;
+  }
+  void *data = mmap(NULL,st.st_size,PROT_READ,MAP_SHARED,fd,0);
+  ::close(fd);
+  if(data == MAP_FAILED)
+    return false;
+  const framebus_header *h = (const framebus_header*)data;
+  atomic_thread_fence(memory_order_acquire);
+  if(h->magic != FRAMEBUS_MAGIC || !h->slots || (h->slots*h->slot_bytes+(sizeof(framebus_header)+63)/64*64) > (size_t)st.st_size){
+    munmap(data,st.st_size);
+    return false;
+  }
+  m_header = h;
+  m_size = st.st_size;
+  return true;
+}
+
+void FrameBusReader::close(){
+  if(!m_header)
+    return;
+  munmap((void*)m_header,m_size);
+  m_header = NULL;
+  m_size = 0;
+}
+
+bool FrameBusReader::latest(framebus_view &view){
+  uint64_t n = published();
+  if(!n)
+    return false;
+  const framebus_slot *slot = slotAt(m_header,n-1);
+  uint64_t seq = slot->seq.load(memory_order_acquire);
+  if(seq & 1)
+    return false;
+  view.slot = slot;
+  view.seq = seq;
+  //clamped, a torn size must not reach past the slot, valid() tells later whether it was torn
+  int rows = min(slot->rows,(int32_t)m_header->height), cols = min(slot->cols,(int32_t)m_header->width);
+  if(rows>0 && cols>0)
+    view.gray = cv::Mat(rows,cols,CV_8UC1,(void*)slot->pixels());
+  else
+    view.gray = cv::Mat();
+  return true;
+}
+
+bool FrameBusReader::valid(const framebus_view &view) const{
+  atomic_thread_fence(memory_order_acquire);//everything read through the view happens before the check
+  return view.slot->seq.load(memory_order_relaxed) == view.seq;
+}
+
+void FrameBusReader::detections(const framebus_view &view, vector<AprilTags::TagDetection> &dets){
+  int n = min((int)view.slot->n_detections,FRAMEBUS_MAX_TAGS);//may be torn, so never trusted as an index
+  dets.resize(n);
+  for(int i = 0;i<n;i++)
+    unpackDetection(view.slot->detections[i],dets[i]);
+}
+
+void FrameBusReader::poses(const framebus_view &view, vector<session_pose> &poses){
+  int n = min((int)view.slot->n_poses,FRAMEBUS_MAX_TAGS);
+  poses.assign(view.slot->poses,view.slot->poses+n);
+}
@@ -0,0 +1,55 @@
+#include "framegrabber.h"
+#include <chrono>
+using namespace std;
+
+LatestFrameGrabber::LatestFrameGrabber():m_camera(NULL),m_running(false),m_skipped(0),m_grabbed(0){}
+
+LatestFrameGrabber::~LatestFrameGrabber(){
+  stop();
+}
+
+void LatestFrameGrabber::start(AprilInterfaceAndVideoCapture &camera){
+  m_camera = &camera;
+  m_running = true;
+  m_thread = thread(&LatestFrameGrabber::run,this);
+}
+
+void LatestFrameGrabber::stop(){
+  if(!m_thread.joinable())
+    return;
+  m_running = false;
+  m_cond.notify_all();
+  m_thread.join();
+}
+
+void LatestFrameGrabber::run(){
+  long frame_id = 0;
+  while(m_running){
+    grabbed_frame &frame = m_slot.writeBuffer();
+    //the slot may still share its pixels with a frame handed out earlier, so grab into fresh images
+    frame.image.release();
+    frame.image_gray.release();
+    if(!m_camera->grabFrame(frame.image,frame.image_gray,frame.t_capture)){
+      if(m_camera->m_replay.isOpened())
+        m_running = false;//end of the replayed session
+      continue;
+    }
+    frame.frame_id = frame_id++;
+    m_grabbed++;
+    if(m_slot.publish())
+      m_skipped++;
+    m_cond.notify_one();
+  }
+}
+
+bool LatestFrameGrabber::latest(grabbed_frame &frame){
+  while(!m_slot.update()){
+    if(!m_running)
+      return false;
+    //the timeout covers a notification sent between the check above and the wait
+    unique_lock<mutex> lock(m_mutex);
+    m_cond.wait_for(lock,chrono::milliseconds(5));
+  }
+  frame = m_slot.readBuffer();
+  return true;
+}
@@ -0,0 +1,82 @@
+#include "overlay.h"
+using namespace std;
+using namespace cv;
+
+void OverlayCompositor::invalidate(){
+  m_layer.release();
+  m_mask.release();
+  m_drawn.clear();
+  m_rcells = m_ccells = -1;
+}
+
+//same look as PathPlannerGrid::drawGrid, drawn on the layer and its mask alike
+void OverlayCompositor::drawGrid(PathPlannerGrid &grid){
+  Scalar col(0,0,0);
+  int r = m_layer.rows, c = m_layer.cols;
+  for(int i = 0;i<r;i += grid.cell_size_y){
+    line(m_layer,Point(0,i),Point(c-1,i),col,1);
+    line(m_mask,Point(0,i),Point(c-1,i),Scalar(255),1);
+  }
+  for(int i = 0;i<c;i += grid.cell_size_x){
+    line(m_layer,Point(i,0),Point(i,r-1),col,1);
+    line(m_mask,Point(i,0),Point(i,r-1),Scalar(255),1);
+  }
+  for(int i = 0;i<grid.rcells;i++)
+    for(int j = 0;j<grid.ccells;j++){
+      if(!grid.isEmpty(i,j)) continue;
+      nd &cell = grid.world_grid[i][j];
+      Point center(cell.tot_x/cell.tot,cell.tot_y/cell.tot);
+      circle(m_layer,center,8,col,2);
+      circle(m_mask,center,8,Scalar(255),2);
+    }
+}
+
+void OverlayCompositor::drawSegments(PathPlannerGrid &plan, int from){
+  for(int i = max(from-1,0);i<plan.total_points-1;i++){
+    Point a(plan.pixel_path_points[i].first,plan.pixel_path_points[i].second);
+    Point b(plan.pixel_path_points[i+1].first,plan.pixel_path_points[i+1].second);
+    line(m_layer,a,b,plan.path_color,2);
+    line(m_mask,a,b,Scalar(255),2);
+  }
+}
+
+void OverlayCompositor::update(PathPlannerGrid &grid, vector<bot_config> &bots, int rows, int cols){
+  bool redraw = m_layer.rows != rows || m_layer.cols != cols || m_rcells != grid.rcells || m_ccells != grid.ccells;
+  for(int i = 1;!redraw && i<bots.size() && i<m_drawn.size();i++)
+    if(bots[i].plan.total_points<m_drawn[i])
+      redraw = true;
+  if(redraw){
+    m_layer.create(rows,cols,CV_8UC3);
+    m_mask.create(rows,cols,CV_8UC1);
+    m_layer.setTo(Scalar(0,0,0));
+    m_mask.setTo(Scalar(0));
+    m_drawn.assign(bots.size(),0);
+    m_rcells = grid.rcells;
+    m_ccells = grid.ccells;
+    drawGrid(grid);
+    m_gray_stale = true;
+  }
+  m_drawn.resize(bots.size(),0);
+  for(int i = 1;i<bots.size();i++){
+    if(bots[i].plan.total_points>m_drawn[i]){
+      drawSegments(bots[i].plan,m_drawn[i]);
+      m_drawn[i] = bots[i].plan.total_points;
+      m_gray_stale = true;
+    }
+  }
+}
+
+void OverlayCompositor::compose(Mat &image){
+  if(m_layer.empty() || image.rows != m_layer.rows || image.cols != m_layer.cols)
+    return;
+  //a single masked copy, which opencv runs row by row with simd, instead of drawing every primitive again
+  if(image.type() == CV_8UC3)
+    m_layer.copyTo(image,m_mask);
+  else if(image.type() == CV_8UC1){
+    if(m_gray_stale){
+      cvtColor(m_layer,m_gray,CV_BGR2GRAY);
+      m_gray_stale = false;
+    }
+    m_gray.copyTo(image,m_mask);
+  }
+}
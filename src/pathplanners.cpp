@@ -1,4 +1,5 @@
 #include "pathplanners.h"
+#include "workerpool.h"
 #include <algorithm>
 #include <cmath>
 #include <queue>
@@ -9,6 +10,37 @@ using namespace Eigen;
 //static members have to be initialized outside class body
 RNG PathPlannerGrid::rng = RNG(12345);
 
+void GridClaims::reset(const vector<vector<nd> > &grid, int rcells, int ccells){
+  if(rcells != m_rcells || ccells != m_ccells){
+    m_owner.reset(new atomic<int>[rcells*ccells]);
+    m_bid.reset(new atomic<int>[rcells*ccells]);
+    m_rcells = rcells;
+    m_ccells = ccells;
+  }
+  for(int r = 0;r<rcells;r++)
+    for(int c = 0;c<ccells;c++){
+      const nd &cell = grid[r][c];
+      set(r,c,!cell.steps ? FREE : cell.r_id>=0 ? cell.r_id : TAKEN);
+      clearBid(r,c);
+    }
+}
+
+void GridClaims::bid(int r,int c,int id){
+  atomic<int> &b = m_bid[r*m_ccells+c];
+  int cur = b.load(memory_order_relaxed);
+  while(id<cur && !b.compare_exchange_weak(cur,id,memory_order_acq_rel));//cur is reloaded on failure
+}
+
+//f(0...n-1) on the workers if there are some
+static void forEach(WorkerPool *workers, int n, const function<void(int)> &f){
+  if(workers){
+    workers->run(n,f);
+    return;
+  }
+  for(int k = 0;k<n;k++)
+    f(k);
+}
+
 double PathPlannerGrid::distance(double x1,double y1,double x2,double y2){
   return sqrt(pow(x1-x2,2) + pow(y1-y2,2));
 }
@@ -109,7 +141,7 @@ bool PathPlannerGrid::pixelIsInsideTag(int x,int y,vector<AprilTags::TagDetectio
 int PathPlannerGrid::setRobotCellCoordinates(vector<AprilTags::TagDetection> &detections){
   if(robot_id < 0){
     if(start_grid_x == start_grid_y && start_grid_x == -1){
-      cout<<"can't find the robot in tags detected"<<endl;
+      TLOG_WARN("can't find the robot in tags detected");
       return -1;
     }
     else
@@ -123,7 +155,7 @@ int PathPlannerGrid::setRobotCellCoordinates(vector<AprilTags::TagDetection> &de
 int PathPlannerGrid::setGoalCellCoordinates(vector<AprilTags::TagDetection> &detections){
   if(goal_id < 0){
     if(goal_grid_x == goal_grid_y && goal_grid_x == -1){
-      cout<<"can't find goal in tags detected"<<endl;
+      TLOG_WARN("can't find goal in tags detected");
       return -1;
     }
     else
@@ -137,7 +169,7 @@ int PathPlannerGrid::setGoalCellCoordinates(vector<AprilTags::TagDetection> &det
 void PathPlannerGrid::drawGrid(Mat &image){
   int channels = image.channels();
   if(channels != 1 && channels != 3){
-    cout<<"can't draw the grid on the given image"<<endl;
+    TLOG_WARN("can't draw the grid on the given image");
     return;
   }
   Vec3b col(0,0,0);
@@ -204,7 +236,7 @@ pair<int,int> PathPlannerGrid::setParentUsingOrientation(robot_pose &ps){
   if(agl<-45 && agl>-135) return pair<int,int> (start_grid_x-1,start_grid_y);
 }
 
-void PathPlannerGrid::addGridCellToPath(int r,int c,AprilInterfaceAndVideoCapture &testbed){
+void PathPlannerGrid::addGridCellToPath(int r,int c,WorldMapping &testbed){
   //cout<<"adding cell "<<r<<" "<<c<<endl;
   int ax,ay;double bx,by;
   world_grid[r][c].r_id = robot_tag_id;//adding this because I can't figure out where in the later code in bsa incremental, I'm not updating the rid of the latest point added
@@ -215,9 +247,11 @@ void PathPlannerGrid::addGridCellToPath(int r,int c,AprilInterfaceAndVideoCaptur
 }
 
 bool PathPlannerGrid::isBlocked(int ngr, int ngc){
-  if(!isEmpty(ngr,ngc) || world_grid[ngr][ngc].steps)
+  if(!isEmpty(ngr,ngc))
     return true;
-  return false;
+  if(claims)
+    return claims->owner(ngr,ngc) != GridClaims::FREE;
+  return world_grid[ngr][ngc].steps;
 }
 
 int PathPlannerGrid::getWallReference(int r,int c,int pr, int pc){
@@ -236,7 +270,7 @@ int PathPlannerGrid::getWallReference(int r,int c,int pr, int pc){
   return -1;//
 }
 //find shortest traversal,populate path_points
-void PathPlannerGrid::findshortest(AprilInterfaceAndVideoCapture &testbed){
+void PathPlannerGrid::findshortest(WorldMapping &testbed){
   if(setRobotCellCoordinates(testbed.detections)<0)
     return;
   if(setGoalCellCoordinates(testbed.detections)<0)
@@ -264,7 +298,7 @@ void PathPlannerGrid::findshortest(AprilInterfaceAndVideoCapture &testbed){
     }
   }
   if(!( t.first == goal_grid_x && t.second == goal_grid_y )){
-    cout<<"no path to reach destination"<<endl;
+    TLOG_INFO("no path to reach destination");
     total_points = -1;//dummy to prevent function recall
     return;
   }
@@ -278,7 +312,7 @@ void PathPlannerGrid::findshortest(AprilInterfaceAndVideoCapture &testbed){
   }
 }
 
-void PathPlannerGrid::addBacktrackPointToStackAndPath(stack<pair<int,int> > &sk,vector<pair<int,int> > &incumbent_cells,int &ic_no,int ngr, int ngc,pair<int,int> &t,AprilInterfaceAndVideoCapture &testbed){
+void PathPlannerGrid::addBacktrackPointToStackAndPath(stack<pair<int,int> > &sk,vector<pair<int,int> > &incumbent_cells,int &ic_no,int ngr, int ngc,pair<int,int> &t,WorldMapping &testbed,int wall){
   if(ic_no){
     incumbent_cells[ic_no] = t; 
     ic_no++;
@@ -289,9 +323,9 @@ void PathPlannerGrid::addBacktrackPointToStackAndPath(stack<pair<int,int> > &sk,
     temp_planner.start_grid_y = incumbent_cells[0].second;
     temp_planner.goal_grid_x = incumbent_cells[ic_no-1].first;
     temp_planner.goal_grid_y = incumbent_cells[ic_no-1].second;
-    cout<<"shortest path started"<<endl;
+    TLOG_DEBUG("shortest path started");
     temp_planner.findshortest(testbed);
-    cout<<"shortest path ended"<<endl;
+    TLOG_DEBUG("shortest path ended");
     for(int i = temp_planner.path_points.size()-1;i>=0;i--){
       addPoint(total_points,temp_planner.pixel_path_points[i].first,temp_planner.pixel_path_points[i].second,temp_planner.path_points[i].x, temp_planner.path_points[i].y);
     }
@@ -301,26 +335,31 @@ void PathPlannerGrid::addBacktrackPointToStackAndPath(stack<pair<int,int> > &sk,
     //}
     ic_no = 0;//reset to zero
   }
-  world_grid[ngr][ngc].wall_reference = getWallReference(t.first,t.second,world_grid[t.first][t.second].parent.first, world_grid[t.first][t.second].parent.second);
+  if(wall == -2)
+    wall = getWallReference(t.first,t.second,world_grid[t.first][t.second].parent.first, world_grid[t.first][t.second].parent.second);
+  world_grid[ngr][ngc].wall_reference = wall;
   world_grid[ngr][ngc].steps = 1;
   world_grid[ngr][ngc].parent = t;
   world_grid[ngr][ngc].r_id = robot_tag_id;
+  if(claims && claims->owner(ngr,ngc) != robot_tag_id)
+    claims->set(ngr,ngc,robot_tag_id);
   addGridCellToPath(ngr,ngc,testbed);
   sk.push(pair<int,int>(ngr,ngc));
 }
 
-int PathPlannerGrid::backtrackSimulateBid(pair<int,int> target,AprilInterfaceAndVideoCapture &testbed){
-  if(setRobotCellCoordinates(testbed.detections)<0)//set the start_grid_y, start_grid_x though we don't needto use them in this function(but is just a weak confirmation that the robot is in current view), doesn't take into account whether the robot is in the current view or not(the variables might be set from before), you need to check it before calling this function to ensure correct response
+int PathPlannerGrid::backtrackSimulateBid(pair<int,int> target,WorldMapping &testbed){
+  if(robot_id<0 && start_grid_x == -1 && start_grid_y == -1)//never seen, start_grid_x and start_grid_y are not needed here(and are only set by the robot's own planning, as the bids of a robot may be computed on several threads at once), doesn't take into account whether the robot is in the current view or not(the variables might be set from before), you need to check it before calling this function to ensure correct response
     return 10000000;
   if(phase == INACTIVE || phase == RETURN || sk.empty())//the robot is inactive
     return 10000000;//it can't ever reach
   stack<pair<int,int> > skc = sk;
-  vector<vector<nd> > world_gridc = world_grid;//copy current grid
-  vector<vector<nd> > tp;//a temporary map
+  vector<vector<nd> > tp = world_grid;//copy current grid
   PathPlannerGrid plannerc(tp);
   plannerc.rcells = rcells;
   plannerc.ccells = ccells;
-  plannerc.world_grid = world_gridc;//world_gridc won't be copied since world_grid is a reference variable
+  //the simulation marks the cells it covers on the copy, so blocking is checked on the copy too, on the shared map
+  //those cells still look free and the spiral steps back and forth between two of them, growing skc without end
+  vector<vector<nd> > &world_gridc = plannerc.world_grid;
   int nx,ny,ngr,ngc,wall;//neighbor row and column
   int step_distance = 0;
   while(true){
@@ -329,7 +368,7 @@ int PathPlannerGrid::backtrackSimulateBid(pair<int,int> target,AprilInterfaceAnd
     ny = t.second-world_gridc[t.first][t.second].parent.second+1;
     if((wall=world_gridc[t.first][t.second].wall_reference)>=0){
       ngr = t.first+aj[nx][ny][wall].first, ngc = t.second+aj[nx][ny][wall].second;
-      if(!isBlocked(ngr,ngc)){
+      if(!plannerc.isBlocked(ngr,ngc)){
         world_gridc[ngr][ngc].wall_reference = -1;
         world_gridc[ngr][ngc].steps = 1;
         world_gridc[ngr][ngc].parent = t;
@@ -346,10 +385,10 @@ int PathPlannerGrid::backtrackSimulateBid(pair<int,int> target,AprilInterfaceAnd
     for(int i = 0;i<4;i++){
       ngr = t.first+aj[nx][ny][i].first;
       ngc = t.second+aj[nx][ny][i].second;
-      if(isBlocked(ngr,ngc))
+      if(plannerc.isBlocked(ngr,ngc))
         continue;
       empty_neighbor_found = true;
-      world_gridc[ngr][ngc].wall_reference = getWallReference(t.first,t.second,world_gridc[t.first][t.second].parent.first, world_gridc[t.first][t.second].parent.second);
+      world_gridc[ngr][ngc].wall_reference = plannerc.getWallReference(t.first,t.second,world_gridc[t.first][t.second].parent.first, world_gridc[t.first][t.second].parent.second);
       world_gridc[ngr][ngc].steps = 1;
       world_gridc[ngr][ngc].parent = t;
       world_gridc[ngr][ngc].r_id = robot_tag_id;
@@ -387,72 +426,87 @@ int PathPlannerGrid::backtrackSimulateBid(pair<int,int> target,AprilInterfaceAnd
   }
   return min_approach;//the robot can't return to given target if min_approach is 10000000
 }
-//each function call adds only the next spiral point in the path vector, which may occur after a return phase
-void PathPlannerGrid::BSACoverageIncremental(AprilInterfaceAndVideoCapture &testbed, robot_pose &ps, double reach_distance, vector<bot_config> &bots){
-  if(setRobotCellCoordinates(testbed.detections)<0)//set the start_grid_y, start_grid_x
-    return;
-  if(!first_call){
-    //cout<<"in second and subsequent calls"<<endl;
-    if(!sk.empty()){
-      pair<int,int> t = sk.top();
-      if(t.first != start_grid_x || t.second != start_grid_y || distance(ps.x,ps.y,path_points[total_points-1].x,path_points[total_points-1].y)>reach_distance){//ensure the robot is continuing from the last point, and that no further planning occurs until the robot reaches the required point
-        cout<<"the robot has not yet reached the old target"<<t.first<<" "<<t.second<<endl;
-        return;
-      }
+//each function call adds the next spiral points in the path vector up to lookahead ahead of the robot, a return phase
+//only once the robot got to the end of the path
+void PathPlannerGrid::BSACoverageIncremental(WorldMapping &testbed, robot_pose &ps, double reach_distance, vector<bot_config> &bots){
+  for(int k = 0;k<lookahead;k++){
+    bsa_move move = BSAProposeIncremental(testbed,ps,reach_distance);
+    if(move.kind == BSA_CLAIM){
+      BSACommitIncremental(move,testbed,ps);
+      BSAAddBacktrackPoints();
+      continue;//speculates that the robot gets there and plans the one after
     }
+    if(move.kind == BSA_FIRST)
+      BSACommitIncremental(move,testbed,ps);
+    else if(move.kind == BSA_BACKTRACK)
+      BSABacktrackIncremental(testbed,bots);
+    return;
   }
-  //cout<<"after first call check"<<endl;
-  vector<pair<int,int> > incumbent_cells(rcells*ccells);//make sure rcells and ccells are defined
-  int ic_no = 0;
+}
+
+int PathPlannerGrid::pointsAhead(robot_pose &ps, double reach_distance){
+  pair<int,int> top = sk.top();
+  if(top.first == start_grid_x && top.second == start_grid_y && distance(ps.x,ps.y,path_points[total_points-1].x,path_points[total_points-1].y)<=reach_distance)
+    return 0;//on the last point, and has to have got to it
+  for(int m = 1;m<lookahead && m<total_points;m++){
+    pair<int,int> &p = pixel_path_points[total_points-1-m];
+    if((p.second-1)/cell_size_y == start_grid_x && (p.first-1)/cell_size_x == start_grid_y)//pixels are indexed from 1
+      return m;
+  }
+  return -1;
+}
 
+bsa_move PathPlannerGrid::BSAProposeIncremental(WorldMapping &testbed, robot_pose &ps, double reach_distance){
+  bsa_move move;
+  if(setRobotCellCoordinates(testbed.detections)<0)//set the start_grid_y, start_grid_x
+    return move;
   if(first_call){
-    first_call = 0;
-    total_points = 0;
-    sk.push(pair<int,int>(start_grid_x,start_grid_y));
-    world_grid[start_grid_x][start_grid_y].parent = setParentUsingOrientation(ps);
-    world_grid[start_grid_x][start_grid_y].steps = 1;//visited
-    world_grid[start_grid_x][start_grid_y].r_id = robot_tag_id;
-    addGridCellToPath(start_grid_x,start_grid_y,testbed);//add the current robot position as target point on first call, on subsequent calls the robot position would already be on the stack from the previous call assuming the function is called only when the robot has reached the next point
-    phase == SPIRAL;
-    return;//added the first spiral point
+    //add the current robot position as target point on first call, on subsequent calls the robot position would already be on the stack from the previous call assuming the function is called only when the robot has reached the next point
+    move.kind = BSA_FIRST;
+    move.cell = pair<int,int>(start_grid_x,start_grid_y);
+    return move;
+  }
+  if(sk.empty())//inactive, nothing was left to cover
+    return move;
+  int ahead = pointsAhead(ps,reach_distance);
+  if(ahead<0){//ensure the robot is continuing from the path, and that no further planning occurs until the robot reaches the required point
+    TLOG_DEBUG("the robot has not yet reached the old target %d %d",sk.top().first,sk.top().second);
+    return move;
   }
+  if(ahead>=lookahead)
+    return move;//enough is planned ahead
+  if(incumbent_cells.size()<rcells*ccells)//make sure rcells and ccells are defined
+    incumbent_cells.resize(rcells*ccells);
+  ic_no = 0;
   int ngr,ngc,wall;//neighbor row and column
 
-  while(!sk.empty()){//when no other explorable path remains, the robot simply keeps updating the path vector with the same grid cell(path point)
+  while(!sk.empty()){
     pair<int,int> t = sk.top();
-    //cout<<"top of stack is "<<t.first<<" "<<t.second<<endl;
     int nx = t.first-world_grid[t.first][t.second].parent.first+1;//add one to avoid negative index
     int ny = t.second-world_grid[t.first][t.second].parent.second+1;
-    if((wall=world_grid[t.first][t.second].wall_reference)>=0){//if the current cell has a wall reference to consider
+    if(ic_no == 0 && (wall=world_grid[t.first][t.second].wall_reference)>=0){//if the current cell has a wall reference to consider
       ngr = t.first+aj[nx][ny][wall].first, ngc = t.second+aj[nx][ny][wall].second;
       if(!isBlocked(ngr,ngc)){
-        if(ic_no == 0){//if you are not backtracking then only proceed, else store the point in possible destinations
-          addBacktrackPointToStackAndPath(sk,incumbent_cells,ic_no,ngr,ngc,t,testbed);
-          world_grid[ngr][ngc].wall_reference = -1;//to prevent wall exchange to right wall when following left wall
-          //cout<<"added a wall reference considered point"<<endl;
-          break;// a new spiral point has been added
-        }
+        move.kind = BSA_CLAIM;
+        move.cell = pair<int,int>(ngr,ngc);
+        move.from = t;
+        move.wall_reference = -1;//to prevent wall exchange to right wall when following left wall
+        return move;
       }
     }
-    bool empty_neighbor_found = false;
-    for(int i = 0;i<4;i++){
+    for(int i = 0;ic_no == 0 && i<4;i++){//once backtracking the rest of the stack is only given up
       ngr = t.first+aj[nx][ny][i].first;
       ngc = t.second+aj[nx][ny][i].second;
-      if(isBlocked(ngr,ngc)){
+      if(isBlocked(ngr,ngc))
         continue;
-      }
-      //cout<<"an empty neighbor is found"<<endl;
-      empty_neighbor_found = true;
-      if(ic_no == 0){
-        addBacktrackPointToStackAndPath(sk,incumbent_cells,ic_no,ngr,ngc,t,testbed);
-        break;
-      }
-      //at this place in an else clause was code for adding a backtrack point
-      //it has since been made incremental and moved from this place to out of while loop
-    }
-    if(empty_neighbor_found && ic_no == 0){
-      break;//a new spiral point has been added and this is not a backtrack iteration
+      move.kind = BSA_CLAIM;
+      move.cell = pair<int,int>(ngr,ngc);
+      move.from = t;
+      move.wall_reference = getWallReference(t.first,t.second,world_grid[t.first][t.second].parent.first, world_grid[t.first][t.second].parent.second);
+      return move;
     }
+    if(ic_no == 0 && ahead>0)
+      return move;//the return phase starts from the robot's cell, it has to get to the end of the path first
     incumbent_cells[ic_no] = t;//add the point as a possible return phase point
     ic_no++;
     sk.pop();
@@ -462,81 +516,123 @@ void PathPlannerGrid::BSACoverageIncremental(AprilInterfaceAndVideoCapture &test
     world_grid[next_below.first][next_below.second].parent = t;
     world_grid[next_below.first][next_below.second].wall_reference = 1;//since turning 180 degrees
   }
-  //cout<<"reached out of while loop, will now check if this is a backtrack interation or a new spiral point has already been added"<<endl;
-  if(ic_no == 0){//spiral point was found, now just add the other empty neighbors as well in bt_destinations and return
-    pair<int,int> tp = sk.top();//tp is the latest point added
-    pair<int,int> t = world_grid[tp.first][tp.second].parent;
-    int nx = t.first-world_grid[t.first][t.second].parent.first+1;//add one to avoid negative index
-    int ny = t.second-world_grid[t.first][t.second].parent.second+1;
-    for(int i = 0;i<4;i++){
-      ngr = t.first+aj[nx][ny][i].first;
-      ngc = t.second+aj[nx][ny][i].second;
-      if((ngr == tp.first && ngc == tp.second) || isBlocked(ngr,ngc) )//ngr,ngc is not a bt point, it is either a spiral point or blocked
-        continue;
-      int id;
-      for(id = 0;id<bt_destinations.size();id++)
-        if(bt_destinations[id].next_p.first == ngr && bt_destinations[id].next_p.second == ngc && bt_destinations[id].parent.second == t.second && bt_destinations[id].parent.first == t.first)//the point was already added before, parent is also checked to make sure we go for the best possible path
-          break;
-      if(id == bt_destinations.size()){//this is new point
-        bt_destinations.push_back(bt(t.first,t.second,ngr,ngc,sk));
-        cout<<"added a new backtrack point "<<ngr<<" "<<ngc<<endl;
-      }
+  move.kind = BSA_BACKTRACK;
+  return move;
+}
+
+void PathPlannerGrid::BSACommitIncremental(const bsa_move &move, WorldMapping &testbed, robot_pose &ps){
+  int r = move.cell.first, c = move.cell.second;
+  if(move.kind == BSA_FIRST){
+    first_call = 0;
+    total_points = 0;
+    sk.push(move.cell);
+    world_grid[r][c].parent = setParentUsingOrientation(ps);
+    world_grid[r][c].steps = 1;//visited
+    world_grid[r][c].r_id = robot_tag_id;
+    if(claims)
+      claims->set(r,c,robot_tag_id);
+    addGridCellToPath(r,c,testbed);
+    return;//added the first spiral point
+  }
+  pair<int,int> t = move.from;
+  int not_returning = 0;
+  addBacktrackPointToStackAndPath(sk,incumbent_cells,not_returning,r,c,t,testbed,move.wall_reference);
+}
+
+//spiral point was found, now just add the other empty neighbors as well in bt_destinations
+void PathPlannerGrid::BSAAddBacktrackPoints(){
+  int ngr,ngc;
+  pair<int,int> tp = sk.top();//tp is the latest point added
+  pair<int,int> t = world_grid[tp.first][tp.second].parent;
+  int nx = t.first-world_grid[t.first][t.second].parent.first+1;//add one to avoid negative index
+  int ny = t.second-world_grid[t.first][t.second].parent.second+1;
+  for(int i = 0;i<4;i++){
+    ngr = t.first+aj[nx][ny][i].first;
+    ngc = t.second+aj[nx][ny][i].second;
+    if((ngr == tp.first && ngc == tp.second) || isBlocked(ngr,ngc) )//ngr,ngc is not a bt point, it is either a spiral point or blocked
+      continue;
+    int id;
+    for(id = 0;id<bt_destinations.size();id++)
+      if(bt_destinations[id].next_p.first == ngr && bt_destinations[id].next_p.second == ngc && bt_destinations[id].parent.second == t.second && bt_destinations[id].parent.first == t.first)//the point was already added before, parent is also checked to make sure we go for the best possible path
+        break;
+    if(id == bt_destinations.size()){//this is new point
+      bt_destinations.push_back(bt(t.first,t.second,ngr,ngc,sk));
+      TLOG_DEBUG("added a new backtrack point %d %d",ngr,ngc);
     }
-    phase = SPIRAL;
-    return;
   }
+  phase = SPIRAL;
+}
 
-  for(int kl = 0;kl<bots.size();kl++){
-    for(int i = 0;i<bots[kl].plan.bt_destinations.size();i++){
-      if(!bots[kl].plan.bt_destinations[i].valid || world_grid[bots[kl].plan.bt_destinations[i].next_p.first][bots[kl].plan.bt_destinations[i].next_p.second].steps>0){//the bt is no longer uncovered
-        bots[kl].plan.bt_destinations[i].valid = false;//the point should no longer be considered in future
-        continue;
-      }
-      cout<<"going for bt point "<<bots[kl].plan.bt_destinations[i].next_p.first<<" "<<bots[kl].plan.bt_destinations[i].next_p.second<<endl;
-      vector<vector<nd> > tp;//a temporary map
-      PathPlannerGrid temp_planner(tp);
-      //temp_planner.gridInversion(*this, robot_tag_id);
-      temp_planner.gridInversion(*this, -1000);
-      temp_planner.start_grid_x = start_grid_x;//the current robot coordinates
-      temp_planner.start_grid_y = start_grid_y;
-      temp_planner.goal_grid_x = bots[kl].plan.bt_destinations[i].parent.first;
-      temp_planner.goal_grid_y = bots[kl].plan.bt_destinations[i].parent.second;
-      temp_planner.findshortest(testbed);
-      bots[kl].plan.bt_destinations[i].manhattan_distance = temp_planner.total_points;//-1 if no path found
+//the stack ran out, go back to the closest backtracking point of any robot for which no other robot is closer
+void PathPlannerGrid::BSABacktrackIncremental(WorldMapping &testbed, vector<bot_config> &bots){
+  //measuring the backtracking points and the bids of the other robots for them only read the shared map, so they
+  //are spread over the workers when there are some
+  vector<pair<int,int> > points;//robot and index of every backtracking point
+  for(int kl = 0;kl<bots.size();kl++)
+    for(int i = 0;i<bots[kl].plan.bt_destinations.size();i++)
+      points.push_back(pair<int,int>(kl,i));
+  forEach(workers,points.size(),[&](int k){
+    bt &point = bots[points[k].first].plan.bt_destinations[points[k].second];
+    if(!point.valid || world_grid[point.next_p.first][point.next_p.second].steps>0){//the bt is no longer uncovered
+      point.valid = false;//the point should no longer be considered in future
+      return;
     }
+    TLOG_DEBUG("going for bt point %d %d",point.next_p.first,point.next_p.second);
+    vector<vector<nd> > tp;//a temporary map
+    PathPlannerGrid temp_planner(tp);
+    //temp_planner.gridInversion(*this, robot_tag_id);
+    temp_planner.gridInversion(*this, -1000);
+    temp_planner.start_grid_x = start_grid_x;//the current robot coordinates
+    temp_planner.start_grid_y = start_grid_y;
+    temp_planner.goal_grid_x = point.parent.first;
+    temp_planner.goal_grid_y = point.parent.second;
+    temp_planner.findshortest(testbed);
+    point.manhattan_distance = temp_planner.total_points;//-1 if no path found
+  });
+  for(int kl = 0;kl<bots.size();kl++){
     sort(bots[kl].plan.bt_destinations.begin(),bots[kl].plan.bt_destinations.end(),[](const bt &a, const bt &b) -> bool{
         return a.manhattan_distance<b.manhattan_distance;
         });
   }
-  int it,mind = 10000000, min_plan = 10000000, min_dist = 10000000;
-  int goodind = 10000000, good_plan = 10000000;//the good dist would be stored in bt_destinations variable of good_plan
-  bool valid_found = false;//a point for which I'm closest is found
-  for(int kl = 0;kl<bots.size();kl++){
-    for(it = 0;it<bots[kl].plan.bt_destinations.size();it++){
-      if(!bots[kl].plan.bt_destinations[it].valid || bots[kl].plan.bt_destinations[it].manhattan_distance<0)//refer line cur - 10
+  //for every robot's points, the first one no other robot is closer to and the closest one looked at before it
+  vector<int> first_good(bots.size()), closest(bots.size());
+  forEach(workers,bots.size(),[&](int kl){
+    vector<bt> &dest = bots[kl].plan.bt_destinations;
+    int it, closest_it = -1;
+    for(it = 0;it<dest.size();it++){
+      if(!dest[it].valid || dest[it].manhattan_distance<0)//refer line cur - 10
         continue;
-      if(bots[kl].plan.bt_destinations[it].manhattan_distance < min_dist){
-        mind = it;//closest valid backtracking point
-        min_plan = kl;
-        min_dist = bots[kl].plan.bt_destinations[it].manhattan_distance;
-      }
-
+      if(closest_it<0 || dest[it].manhattan_distance < dest[closest_it].manhattan_distance)
+        closest_it = it;
       int i;
       for(i = 0;i<bots.size();i++){
         if(bots[i].plan.robot_id == origin_id || bots[i].plan.robot_id == robot_id)//the tag is actually the origin or current robot itself
           continue;
         //all planners must share the same map
-        int tp = bots[i].plan.backtrackSimulateBid(bots[kl].plan.bt_destinations[it].next_p,testbed);// returns 10000000 if no path
-        if(tp<bots[kl].plan.bt_destinations[it].manhattan_distance)//a closer bot is available
+        int tp = bots[i].plan.backtrackSimulateBid(dest[it].next_p,testbed);// returns 10000000 if no path
+        if(tp<dest[it].manhattan_distance)//a closer bot is available
           break;
       }
-      if(i == bots.size()){
-        valid_found = true;
+      if(i == bots.size())
         break;
-      }
     }
-    if(it < bots[kl].plan.bt_destinations.size()){//a good point was found
-      if(goodind == 10000000 || bots[good_plan].plan.bt_destinations[goodind].manhattan_distance > bots[kl].plan.bt_destinations[it].manhattan_distance){
+    first_good[kl] = it;
+    closest[kl] = closest_it;
+  });
+  int mind = 10000000, min_plan = 10000000, min_dist = 10000000;
+  int goodind = 10000000, good_plan = 10000000;//the good dist would be stored in bt_destinations variable of good_plan
+  bool valid_found = false;//a point for which I'm closest is found
+  for(int kl = 0;kl<bots.size();kl++){
+    vector<bt> &dest = bots[kl].plan.bt_destinations;
+    if(closest[kl]>=0 && dest[closest[kl]].manhattan_distance < min_dist){
+      mind = closest[kl];//closest valid backtracking point
+      min_plan = kl;
+      min_dist = dest[closest[kl]].manhattan_distance;
+    }
+    int it = first_good[kl];
+    if(it < dest.size()){//a good point was found
+      valid_found = true;
+      if(goodind == 10000000 || bots[good_plan].plan.bt_destinations[goodind].manhattan_distance > dest[it].manhattan_distance){
         goodind = it;
         good_plan = kl;
       }
@@ -544,7 +640,7 @@ void PathPlannerGrid::BSACoverageIncremental(AprilInterfaceAndVideoCapture &test
   }
 
   if(!valid_found && mind == 10000000){//no bt point left
-    cout<<"no bt point left for robot "<<robot_tag_id<<endl;
+    TLOG_INFO("no bt point left for robot %d",robot_tag_id);
     phase = INACTIVE;
     return;
   }
@@ -561,7 +657,7 @@ void PathPlannerGrid::BSACoverageIncremental(AprilInterfaceAndVideoCapture &test
 }
 
 
-void PathPlannerGrid::BSACoverage(AprilInterfaceAndVideoCapture &testbed,robot_pose &ps){
+void PathPlannerGrid::BSACoverage(WorldMapping &testbed,robot_pose &ps){
   if(setRobotCellCoordinates(testbed.detections)<0)
     return;
   vector<pair<int,int> > incumbent_cells(rcells*ccells);
@@ -607,7 +703,7 @@ void PathPlannerGrid::BSACoverage(AprilInterfaceAndVideoCapture &testbed,robot_p
     world_grid[next_below.first][next_below.second].wall_reference = 1;//since turning 180 degrees
   }
 }
-void PathPlannerGrid::findCoverageLocalNeighborPreference(AprilInterfaceAndVideoCapture &testbed,robot_pose &ps){
+void PathPlannerGrid::findCoverageLocalNeighborPreference(WorldMapping &testbed,robot_pose &ps){
   if(setRobotCellCoordinates(testbed.detections)<0)
     return;
   vector<pair<int,int> > incumbent_cells(rcells*ccells);
@@ -644,7 +740,7 @@ void PathPlannerGrid::findCoverageLocalNeighborPreference(AprilInterfaceAndVideo
     world_grid[next_below.first][next_below.second].parent = t;
   }
 }
-void PathPlannerGrid::findCoverageGlobalNeighborPreference(AprilInterfaceAndVideoCapture &testbed){
+void PathPlannerGrid::findCoverageGlobalNeighborPreference(WorldMapping &testbed){
   if(setRobotCellCoordinates(testbed.detections)<0)
     return;
   vector<pair<int,int> > incumbent_cells(rcells*ccells);
@@ -0,0 +1,311 @@
+#include "posefilter.h"
+#include <cmath>
+using namespace std;
+
+static double wrapAngle(double a){
+  while(a>PI)
+    a -= TWOPI;
+  while(a<-PI)
+    a += TWOPI;
+  return a;
+}
+
+//kalman update with the measurement model z = H*s
+template <int M>
+static void update(PoseFilter::state &s, PoseFilter::covariance &P, const Eigen::Matrix<double,M,5> &H,
+    const Eigen::Matrix<double,M,1> &innovation, const Eigen::Matrix<double,M,M> &R){
+  Eigen::Matrix<double,M,M> S = H*P*H.transpose()+R;
+  Eigen::Matrix<double,5,M> K = P*H.transpose()*S.inverse();
+  s += K*innovation;
+  P = (PoseFilter::covariance::Identity()-K*H)*P;
+  P = (P+P.transpose())/2;//keeps rounding from breaking the symmetry
+}
+
+void PoseFilter::propagate(state &st, covariance &cov, double dt, const pose_filter_params &p){
+  double c = cos(st(2)), sn = sin(st(2)), v = st(3);
+  covariance F = covariance::Identity();
+  F(0,2) = -v*sn*dt;
+  F(0,3) = c*dt;
+  F(1,2) = v*c*dt;
+  F(1,3) = sn*dt;
+  F(2,4) = dt;
+  st(0) += v*c*dt;
+  st(1) += v*sn*dt;
+  st(2) = wrapAngle(st(2)+st(4)*dt);
+  //speed and turn rate drift as random walks, their integrals spread the position and heading
+  double qa = p.accel_sigma*p.accel_sigma, qt = p.turn_accel_sigma*p.turn_accel_sigma;
+  covariance Q = covariance::Zero();
+  Q(0,0) = Q(1,1) = qa*dt*dt*dt/3;
+  Q(2,2) = qt*dt*dt*dt/3;
+  Q(3,3) = qa*dt;
+  Q(4,4) = qt*dt;
+  cov = F*cov*F.transpose()+Q;
+}
+
+void PoseFilter::predict(double t_to){
+  if(!initialized || t_to<=t)
+    return;
+  propagate(s,P,t_to-t,params);
+  t = t_to;
+}
+
+void PoseFilter::correct(const robot_pose &rp, double t_meas){
+  if(!initialized){
+    s << rp.x,rp.y,rp.omega,0,0;
+    P = covariance::Zero();
+    P(0,0) = P(1,1) = params.position_sigma*params.position_sigma;
+    P(2,2) = params.heading_sigma*params.heading_sigma;
+    P(3,3) = params.accel_sigma*params.accel_sigma;//about a second's worth of acceleration
+    P(4,4) = params.turn_accel_sigma*params.turn_accel_sigma;
+    t = t_meas;
+    initialized = true;
+    return;
+  }
+  predict(t_meas);
+  Eigen::Matrix<double,3,5> H = Eigen::Matrix<double,3,5>::Zero();
+  H(0,0) = H(1,1) = H(2,2) = 1;
+  Eigen::Matrix<double,3,1> innovation(rp.x-s(0),rp.y-s(1),wrapAngle(rp.omega-s(2)));
+  Eigen::Matrix3d R = Eigen::Matrix3d::Zero();
+  R(0,0) = R(1,1) = params.position_sigma*params.position_sigma;
+  R(2,2) = params.heading_sigma*params.heading_sigma;
+  update<3>(s,P,H,innovation,R);
+  s(2) = wrapAngle(s(2));
+}
+
+void PoseFilter::command(int left, int right, double t_cmd){
+  if(!initialized || params.velocity_scale<=0)
+    return;
+  predict(t_cmd);
+  double v = params.velocity_scale*(left+right)/2, w = params.velocity_scale*(right-left)/params.axle_length;
+  Eigen::Matrix<double,2,5> H = Eigen::Matrix<double,2,5>::Zero();
+  H(0,3) = H(1,4) = 1;
+  Eigen::Matrix<double,2,1> innovation(v-s(3),w-s(4));
+  double sw = 2*params.command_sigma/params.axle_length;
+  Eigen::Matrix2d R = Eigen::Matrix2d::Zero();
+  R(0,0) = params.command_sigma*params.command_sigma;
+  R(1,1) = sw*sw;
+  update<2>(s,P,H,innovation,R);
+}
+
+void PoseFilter::ahead(double t_at, state &st, covariance &cov) const{
+  st = s;
+  cov = P;
+  if(initialized && t_at>t)
+    propagate(st,cov,t_at-t,params);
+}
+
+robot_pose PoseFilter::predicted(double t_at) const{
+  state st;
+  covariance cov;
+  ahead(t_at,st,cov);
+  robot_pose rp;
+  rp.x = st(0), rp.y = st(1), rp.omega = st(2);
+  return rp;
+}
+
+robot_pose PoseFilter::pose() const{
+  robot_pose rp;
+  rp.x = s(0), rp.y = s(1), rp.omega = s(2);
+  return rp;
+}
+
+double PoseFilter::positionSigma(double t_at) const{
+  state st;
+  covariance cov;
+  ahead(t_at,st,cov);
+  //largest eigenvalue of the 2x2 position block
+  double a = cov(0,0), b = cov(0,1), d = cov(1,1);
+  return sqrt((a+d)/2+sqrt((a-d)*(a-d)/4+b*b));
+}
+
+void PoseTracker::setPlane(WorldMapping &mapping, int width, int height){
+  HomographyMapping to_world;
+  to_world.fit(mapping,width,height);
+  lock_guard<mutex> lock(m_lock);
+  m_to_pixel = to_world.H.inverse();
+  m_has_plane = true;
+}
+
+PoseTracker::track* PoseTracker::find(int id, double t){
+  if(id<0 || id>=(int)m_tracks.size() || !m_tracks[id].live)
+    return NULL;
+  track &tr = m_tracks[id];
+  if(t-tr.t_last>max_age){
+    tr.live = false;//lost, a new detection starts it over
+    return NULL;
+  }
+  return &tr;
+}
+
+void PoseTracker::correct(const AprilTags::TagDetection &det, const robot_pose &rp, double t){
+  lock_guard<mutex> lock(m_lock);
+  if(det.id<0)
+    return;
+  if(det.id>=(int)m_tracks.size())
+    m_tracks.resize(det.id+1);
+  track *tr = find(det.id,t);
+  if(!tr){
+    tr = &m_tracks[det.id];
+    tr->filter = PoseFilter(params);
+  }
+  tr->filter.correct(rp,t);
+  tr->last = det;
+  tr->last_pose = tr->filter.pose();
+  tr->t_last = t;
+  tr->live = true;
+}
+
+void PoseTracker::command(int id, int left, int right, double t){
+  lock_guard<mutex> lock(m_lock);
+  track *tr = find(id,t);
+  if(tr)
+    tr->filter.command(left,right,t);
+}
+
+bool PoseTracker::predict(int id, double t, robot_pose &rp){
+  lock_guard<mutex> lock(m_lock);
+  track *tr = find(id,t);
+  if(!tr)
+    return false;
+  rp = tr->filter.predicted(t);
+  return true;
+}
+
+bool PoseTracker::confident(double t){
+  lock_guard<mutex> lock(m_lock);
+  bool any = false;
+  for(int i = 0;i<m_tracks.size();i++){
+    track *tr = find(i,t);
+    if(!tr)
+      continue;
+    if(tr->filter.positionSigma(t)>confident_sigma)
+      return false;
+    any = true;
+  }
+  return any;
+}
+
+bool PoseTracker::toPixel(const robot_pose &rp, double &px, double &py){
+  Eigen::Vector3d p = m_to_pixel*Eigen::Vector3d(rp.x,rp.y,1);
+  if(fabs(p(2))<1e-12)
+    return false;
+  px = p(0)/p(2);
+  py = p(1)/p(2);
+  return true;
+}
+
+//the last detection moved by the pixel displacement of the predicted pose, the tag is on top of the robot
+//so mapping the pose itself would be off by the height of the tag, the displacement mostly cancels it
+AprilTags::TagDetection PoseTracker::moved(track &tr, double t){
+  AprilTags::TagDetection det = tr.last;
+  double x0, y0, x1, y1;
+  if(!m_has_plane || !toPixel(tr.last_pose,x0,y0) || !toPixel(tr.filter.predicted(t),x1,y1))
+    return det;
+  float dx = x1-x0, dy = y1-y0;
+  for(int k = 0;k<4;k++){
+    det.p[k].first += dx;
+    det.p[k].second += dy;
+  }
+  det.cxy.first += dx;
+  det.cxy.second += dy;
+  det.hxy.first += dx;//the homography is relative to hxy, so it moves along
+  det.hxy.second += dy;
+  return det;
+}
+
+void PoseTracker::searchWindows(double t, int width, int height, vector<cv::Rect> &windows){
+  lock_guard<mutex> lock(m_lock);
+  windows.clear();
+  cv::Rect image_rect(0,0,width,height);
+  for(int i = 0;i<m_tracks.size();i++){
+    track *tr = find(i,t);
+    if(!tr)
+      continue;
+    AprilTags::TagDetection det = moved(*tr,t);
+    double half = 0;
+    for(int k = 0;k<4;k++)
+      half = max(half,(double)hypot(det.p[k].first-det.cxy.first,det.p[k].second-det.cxy.second));
+    //three sigma of the position, scaled to pixels around the predicted pose
+    robot_pose rp = tr->filter.predicted(t), rx = rp;
+    rx.x += 1;
+    double x0, y0, x1, y1, pixels_per_unit = 1;
+    if(m_has_plane && toPixel(rp,x0,y0) && toPixel(rx,x1,y1))
+      pixels_per_unit = hypot(x1-x0,y1-y0);
+    half += 3*tr->filter.positionSigma(t)*pixels_per_unit+margin;
+    cv::Rect r = cv::Rect(cvRound(det.cxy.first-half),cvRound(det.cxy.second-half),cvRound(2*half),cvRound(2*half)) & image_rect;
+    if(r.area()>0)
+      windows.push_back(r);
+  }
+  //a tag cut in two by neighbouring windows would be missed, so overlapping windows become one
+  for(int i = 0;i<windows.size();i++){
+    for(int j = i+1;j<windows.size();j++){
+      if((windows[i] & windows[j]).area()>0){
+        windows[i] |= windows[j];
+        windows.erase(windows.begin()+j);
+        j = i;//the grown window may now overlap earlier ones
+      }
+    }
+  }
+}
+
+void PoseTracker::fillMissing(double t, vector<AprilTags::TagDetection> &dets){
+  lock_guard<mutex> lock(m_lock);
+  vector<char> seen(m_tracks.size(),0);
+  for(int i = 0;i<dets.size();i++)
+    if(dets[i].id>=0 && dets[i].id<(int)seen.size())
+      seen[dets[i].id] = 1;
+  for(int i = 0;i<m_tracks.size();i++){
+    track *tr = find(i,t);
+    if(tr && !seen[i])
+      dets.push_back(moved(*tr,t));
+  }
+}
+
+void PoseHistory::add(int id, double t, const robot_pose &rp){
+  lock_guard<mutex> lock(m_lock);
+  if(id<0)
+    return;
+  if(id>=(int)m_rings.size())
+    m_rings.resize(id+1);
+  ring &r = m_rings[id];
+  if(r.samples.empty())
+    r.samples.resize(m_capacity);
+  if(r.count && t<=r.samples[(r.next+m_capacity-1)%m_capacity].t)
+    return;
+  r.samples[r.next].t = t;
+  r.samples[r.next].pose = rp;
+  r.next = (r.next+1)%m_capacity;
+  r.count = min(r.count+1,m_capacity);
+  m_newest = max(m_newest,t);
+}
+
+bool PoseHistory::extrapolate(int id, double t, robot_pose &rp){
+  lock_guard<mutex> lock(m_lock);
+  if(id<0 || id>=(int)m_rings.size() || !m_rings[id].count)
+    return false;
+  ring &r = m_rings[id];
+  const pose_sample &last = r.samples[(r.next+m_capacity-1)%m_capacity];
+  if(t-last.t>max_age)
+    return false;
+  rp = last.pose;
+  //velocity from the newest sample at least min_span older than the last one, or the oldest one kept
+  const pose_sample *first = NULL;
+  for(int k = 2;k<=r.count;k++){
+    first = &r.samples[(r.next+m_capacity-k)%m_capacity];
+    if(last.t-first->t>=min_span)
+      break;
+  }
+  double dt = min(t-last.t,max_horizon);
+  if(!first || dt<=0)
+    return true;
+  double span = last.t-first->t;
+  rp.x += (last.pose.x-first->pose.x)/span*dt;
+  rp.y += (last.pose.y-first->pose.y)/span*dt;
+  rp.omega = wrapAngle(rp.omega+wrapAngle(last.pose.omega-first->pose.omega)/span*dt);
+  return true;
+}
+
+double PoseHistory::newest(){
+  lock_guard<mutex> lock(m_lock);
+  return m_newest;
+}
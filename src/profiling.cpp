@@ -0,0 +1,231 @@
+#include "profiling.h"
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <algorithm>
+#include "aprilvideointerface.h"
+using namespace std;
+
+#define BUCKETS_PER_OCTAVE 8
+#define OCTAVES 24//1us to about 16s, longer samples go to the last bucket
+#define SMALLEST 1e-6
+
+Histogram::Histogram():m_buckets(BUCKETS_PER_OCTAVE*OCTAVES+1){
+  clear();
+}
+
+void Histogram::clear(){
+  fill(m_buckets.begin(),m_buckets.end(),0);
+  m_count = 0;
+  m_sum = m_max = 0;
+  m_min = 1e300;
+}
+
+void Histogram::add(double seconds){
+  int b = 0;
+  if(seconds > SMALLEST)
+    b = std::min((int)m_buckets.size()-1,1+(int)(log2(seconds/SMALLEST)*BUCKETS_PER_OCTAVE));
+  m_buckets[b]++;
+  m_count++;
+  m_sum += seconds;
+  if(seconds < m_min) m_min = seconds;
+  if(seconds > m_max) m_max = seconds;
+}
+
+double Histogram::percentile(double p) const{
+  if(!m_count)
+    return 0;
+  unsigned long rank = (unsigned long)ceil(p*m_count);
+  if(rank < 1) rank = 1;
+  unsigned long seen = 0;
+  for(int b = 0;b<m_buckets.size();b++){
+    seen += m_buckets[b];
+    if(seen >= rank){
+      double edge = SMALLEST*pow(2.0,(double)b/BUCKETS_PER_OCTAVE);
+      return edge < m_max ? edge : m_max;//never report more than was seen
+    }
+  }
+  return m_max;
+}
+
+const char *DetectorProfiler::stage_names[DetectorProfiler::STAGES] = {"convert","blur","gradient","edges","sort","merge","clusters","segments","quads","decode","dedup","total"};
+const char *DetectorProfiler::counter_names[DetectorProfiler::COUNTERS] = {"edges","clusters","segments","quads","detections","tags"};
+
+DetectorProfiler::DetectorProfiler(){
+  clear();
+}
+
+void DetectorProfiler::clear(){
+  for(int i = 0;i<STAGES;i++)
+    m_stages[i].clear();
+  for(int i = 0;i<COUNTERS;i++){
+    m_counter_sums[i] = 0;
+    m_counter_max[i] = 0;
+  }
+  m_frames = 0;
+}
+
+void DetectorProfiler::add(const AprilTags::TagDetectorStats &s){
+  double t[STAGES] = {s.convert,s.blur,s.gradient,s.edges,s.sort,s.merge,s.clusters,s.segments,s.quads,s.decode,s.dedup,s.total};
+  int c[COUNTERS] = {s.nEdges,s.nClusters,s.nSegments,s.nQuads,s.nDetections,s.nTags};
+  for(int i = 0;i<STAGES;i++)
+    m_stages[i].add(t[i]);
+  for(int i = 0;i<COUNTERS;i++){
+    m_counter_sums[i] += c[i];
+    if(c[i] > m_counter_max[i])
+      m_counter_max[i] = c[i];
+  }
+  m_frames++;
+}
+
+void DetectorProfiler::print(ostream &out) const{
+  ios::fmtflags flags = out.flags();
+  streamsize precision = out.precision();
+  out << "detector stages over " << m_frames << " frames (ms, mean p50 p99 max):" << endl;
+  out << fixed << setprecision(3);
+  for(int i = 0;i<STAGES;i++){
+    const Histogram &h = m_stages[i];
+    out << "  " << setw(9) << left << stage_names[i] << right << setw(9) << 1000*h.mean() << setw(9) << 1000*h.percentile(0.5)
+        << setw(9) << 1000*h.percentile(0.99) << setw(9) << 1000*h.max() << endl;
+  }
+  out.flags(flags);
+  out.precision(precision);
+  out << "  counts (mean):";
+  for(int i = 0;i<COUNTERS;i++)
+    out << " " << counter_names[i] << "=" << (m_frames ? m_counter_sums[i]/m_frames : 0);
+  out << endl;
+}
+
+void DetectorProfiler::writeCSV(ostream &out) const{
+  out << "stage,frames,mean_ms,p50_ms,p99_ms,min_ms,max_ms" << endl;
+  for(int i = 0;i<STAGES;i++){
+    const Histogram &h = m_stages[i];
+    out << stage_names[i] << "," << h.count() << "," << 1000*h.mean() << "," << 1000*h.percentile(0.5) << ","
+        << 1000*h.percentile(0.99) << "," << 1000*h.min() << "," << 1000*h.max() << endl;
+  }
+  out << endl << "counter,frames,mean,max" << endl;
+  for(int i = 0;i<COUNTERS;i++)
+    out << counter_names[i] << "," << m_frames << "," << (m_frames ? m_counter_sums[i]/m_frames : 0) << "," << m_counter_max[i] << endl;
+}
+
+void DetectorProfiler::writeJSON(ostream &out) const{
+  out << "{\n  \"frames\": " << m_frames << ",\n  \"stages_ms\": {\n";
+  for(int i = 0;i<STAGES;i++){
+    const Histogram &h = m_stages[i];
+    out << "    \"" << stage_names[i] << "\": {\"mean\": " << 1000*h.mean() << ", \"p50\": " << 1000*h.percentile(0.5)
+        << ", \"p99\": " << 1000*h.percentile(0.99) << ", \"min\": " << 1000*h.min() << ", \"max\": " << 1000*h.max() << "}"
+        << (i+1<STAGES ? ",\n" : "\n");
+  }
+  out << "  },\n  \"counters\": {\n";
+  for(int i = 0;i<COUNTERS;i++){
+    out << "    \"" << counter_names[i] << "\": {\"mean\": " << (m_frames ? m_counter_sums[i]/m_frames : 0) << ", \"max\": " << m_counter_max[i] << "}"
+        << (i+1<COUNTERS ? ",\n" : "\n");
+  }
+  out << "  }\n}\n";
+}
+
+bool DetectorProfiler::write(const string &path) const{
+  ofstream out(path.c_str());
+  if(!out)
+    return false;
+  if(path.size() >= 5 && path.compare(path.size()-5,5,".json") == 0)
+    writeJSON(out);
+  else
+    writeCSV(out);
+  return true;
+}
+
+const char *LatencyTracer::stage_names[TRACE_STAGES] = {"captured","detected","posed","planned","enqueued","written"};
+
+void frame_trace::reset(long id, double t_capture){
+  frame_id = id;
+  t[TRACE_CAPTURED] = t_capture;
+  for(int i = 1;i<TRACE_STAGES;i++)
+    t[i] = 0;
+}
+
+void frame_trace::mark(int stage){
+  t[stage] = tic();
+}
+
+void LatencyTracer::addStage(const frame_trace &trace, int stage){//m_lock must be held
+  m_since_capture[stage].add(trace.t[stage]-trace.t[TRACE_CAPTURED]);
+  for(int prev = stage-1;prev >= 0;prev--)
+    if(trace.t[prev] > 0){
+      m_step[stage].add(trace.t[stage]-trace.t[prev]);
+      break;
+    }
+}
+
+void LatencyTracer::add(const frame_trace &trace){
+  lock_guard<mutex> lock(m_lock);
+  for(int i = 1;i<TRACE_WRITTEN;i++)
+    if(trace.t[i] > 0)
+      addStage(trace,i);
+  if(trace.frame_id >= 0)
+    m_pending[trace.frame_id%PENDING] = trace;
+}
+
+void LatencyTracer::enqueued(long frame_id){
+  double t = tic();
+  if(frame_id < 0)
+    return;
+  lock_guard<mutex> lock(m_lock);
+  frame_trace &trace = m_pending[frame_id%PENDING];
+  if(trace.frame_id != frame_id || trace.t[TRACE_ENQUEUED] > 0)
+    return;
+  trace.t[TRACE_ENQUEUED] = t;
+  addStage(trace,TRACE_ENQUEUED);
+}
+
+void LatencyTracer::written(long frame_id){
+  double t = tic();
+  if(frame_id < 0)
+    return;
+  lock_guard<mutex> lock(m_lock);
+  frame_trace &trace = m_pending[frame_id%PENDING];
+  if(trace.frame_id != frame_id || trace.t[TRACE_ENQUEUED] == 0 || trace.t[TRACE_WRITTEN] > 0)//overwritten by a newer frame, or written on another port
+    return;
+  trace.t[TRACE_WRITTEN] = t;
+  addStage(trace,TRACE_WRITTEN);
+}
+
+unsigned long LatencyTracer::frames(){
+  lock_guard<mutex> lock(m_lock);
+  return m_since_capture[TRACE_DETECTED].count();
+}
+
+double LatencyTracer::percentile(int stage, double p){
+  lock_guard<mutex> lock(m_lock);
+  return m_since_capture[stage].percentile(p);
+}
+
+void LatencyTracer::print(ostream &out){
+  lock_guard<mutex> lock(m_lock);
+  ios::fmtflags flags = out.flags();
+  streamsize precision = out.precision();
+  out << "latency over " << m_since_capture[TRACE_DETECTED].count() << " frames (ms, mean p50 p99 max, from capture | from the previous stage):" << endl;
+  out << fixed << setprecision(3);
+  for(int i = 1;i<TRACE_STAGES;i++){
+    const Histogram &h = m_since_capture[i], &s = m_step[i];
+    out << "  " << setw(9) << left << stage_names[i] << right << setw(9) << 1000*h.mean() << setw(9) << 1000*h.percentile(0.5)
+        << setw(9) << 1000*h.percentile(0.99) << setw(9) << 1000*h.max() << "  |" << setw(9) << 1000*s.mean() << setw(9)
+        << 1000*s.percentile(0.5) << setw(9) << 1000*s.percentile(0.99) << setw(9) << 1000*s.max() << endl;
+  }
+  out.flags(flags);
+  out.precision(precision);
+}
+
+bool LatencyTracer::write(const string &path){
+  ofstream out(path.c_str());
+  if(!out)
+    return false;
+  lock_guard<mutex> lock(m_lock);
+  out << "stage,frames,mean_ms,p50_ms,p99_ms,max_ms,step_mean_ms,step_p50_ms,step_p99_ms,step_max_ms" << endl;
+  for(int i = 1;i<TRACE_STAGES;i++){
+    const Histogram &h = m_since_capture[i], &s = m_step[i];
+    out << stage_names[i] << "," << h.count() << "," << 1000*h.mean() << "," << 1000*h.percentile(0.5) << "," << 1000*h.percentile(0.99)
+        << "," << 1000*h.max() << "," << 1000*s.mean() << "," << 1000*s.percentile(0.5) << "," << 1000*s.percentile(0.99) << "," << 1000*s.max() << endl;
+  }
+  return true;
+}
@@ -0,0 +1,111 @@
+#include "serialreader.h"
+#include <poll.h>
+#include <unistd.h>
+#include <errno.h>
+#include <algorithm>
+using namespace std;
+
+SerialReader::SerialReader(int buffer_size, int max_frame):m_fd(-1),m_delimiter('\n'),m_ring(max(buffer_size,2*max_frame)),m_head(0),m_count(0),m_scanned(0),m_frame(max_frame),m_max_frame(max_frame),m_running(false),m_bytes(0),m_frames(0),m_overflows(0){
+  m_wake[0] = m_wake[1] = -1;
+}
+
+SerialReader::~SerialReader(){
+  stop();
+}
+
+void SerialReader::start(int fd, unsigned char delimiter, FrameCallback cb){
+  m_fd = fd;
+  m_delimiter = delimiter;
+  m_callback = cb;
+  m_head = m_count = m_scanned = 0;
+  if(pipe(m_wake) != 0)
+    m_wake[0] = m_wake[1] = -1;
+  m_running = true;
+  m_thread = thread(&SerialReader::run,this);
+}
+
+void SerialReader::stop(){
+  if(!m_thread.joinable())
+    return;
+  m_running = false;
+  if(m_wake[1] >= 0){
+    char c = 0;
+    int res = ::write(m_wake[1],&c,1);
+  }
+  m_thread.join();
+  for(int i = 0;i<2;i++){
+    if(m_wake[i] >= 0)
+      close(m_wake[i]);
+    m_wake[i] = -1;
+  }
+}
+
+void SerialReader::run(){
+  struct pollfd fds[2];
+  fds[0].fd = m_fd;
+  fds[0].events = POLLIN;
+  fds[1].fd = m_wake[0];
+  fds[1].events = POLLIN;
+  size_t size = m_ring.size();
+  while(m_running){
+    fds[0].revents = fds[1].revents = 0;
+    int r = poll(fds,m_wake[0] >= 0 ? 2 : 1,m_wake[0] >= 0 ? -1 : 100);//without the wake pipe fall back to a timeout
+    if(r<0){
+      if(errno == EINTR) continue;
+      break;
+    }
+    if(fds[1].revents)//stop requested
+      break;
+    if(!(fds[0].revents & POLLIN)){
+      if(fds[0].revents & (POLLERR | POLLHUP | POLLNVAL))//port went away
+        break;
+      continue;
+    }
+    //read as much as fits in the contiguous free part of the ring
+    size_t tail = (m_head+m_count)%size;
+    size_t len = min(size-m_count,size-tail);
+    ssize_t n = ::read(m_fd,&m_ring[tail],len);
+    if(n == 0)
+      break;
+    if(n<0){
+      if(errno == EAGAIN || errno == EINTR) continue;
+      break;
+    }
+    m_count += n;
+    m_bytes += n;
+    extractFrames();
+  }
+}
+
+void SerialReader::extractFrames(){
+  size_t size = m_ring.size();
+  while(m_count){
+    size_t len = 0;
+    size_t limit = min(m_count,(size_t)m_max_frame);
+    for(size_t i = m_scanned;i<limit;i++)
+      if(m_ring[(m_head+i)%size] == m_delimiter){
+        len = i+1;
+        break;
+      }
+    if(!len){
+      if(m_count < (size_t)m_max_frame){
+        m_scanned = m_count;//wait for more bytes
+        return;
+      }
+      len = m_max_frame;//no delimiter within the maximum frame length, deliver what we have
+      m_overflows++;
+    }
+    if(m_head+len <= size)
+      m_callback(&m_ring[m_head],len);
+    else{
+      size_t first = size-m_head;
+      copy(m_ring.begin()+m_head,m_ring.end(),m_frame.begin());
+      copy(m_ring.begin(),m_ring.begin()+(len-first),m_frame.begin()+first);
+      m_callback(m_frame.data(),len);
+    }
+    m_head = (m_head+len)%size;
+    m_count -= len;
+    m_scanned = 0;
+    m_frames++;
+  }
+}
@@ -0,0 +1,122 @@
+#include "serialwriter.h"
+#include <cstring>
+#include <chrono>
+using namespace std;
+
+AsyncSerialWriter::AsyncSerialWriter(int capacity):m_queue(capacity),m_running(false),m_sent(0),m_dropped(0),m_coalesced(0),m_bytes(0),m_handed(0),m_done(0),m_epoch(0),m_written(0){}
+
+AsyncSerialWriter::~AsyncSerialWriter(){
+  stop();
+}
+
+void AsyncSerialWriter::open(const string& port, int rate){
+  m_serial.open(port,rate);
+  m_running = true;
+  m_thread = thread(&AsyncSerialWriter::run,this);
+}
+
+bool AsyncSerialWriter::send(const unsigned char* buf, int len, long tag){
+  serial_message msg;
+  if(len>FRAME_MAX_SIZE){
+    m_dropped++;
+    return false;
+  }
+  msg.tag = tag;
+  msg.epoch = m_epoch+1;
+  msg.len = len;
+  memcpy(msg.data,buf,len);
+  if(!m_queue.push(msg)){
+    m_dropped++;
+    return false;
+  }
+  m_epoch = msg.epoch;//after the push, a latest value older than the epoch always finds its replacement queued
+  m_handed++;
+  wake();
+  return true;
+}
+
+void AsyncSerialWriter::sendLatest(const unsigned char* buf, int len, long tag){
+  if(len>FRAME_MAX_SIZE){
+    m_dropped++;
+    return;
+  }
+  serial_message &msg = m_latest.writeBuffer();
+  msg.tag = tag;
+  msg.epoch = m_epoch;
+  msg.len = len;
+  memcpy(msg.data,buf,len);
+  if(m_latest.publish())
+    m_coalesced++;//the overwritten value will never be written
+  else
+    m_handed++;
+  wake();
+}
+
+void AsyncSerialWriter::flush(){
+  while(m_running && m_done.load() < m_handed.load())
+    this_thread::sleep_for(chrono::microseconds(500));
+}
+
+void AsyncSerialWriter::stop(){
+  if(!m_thread.joinable())
+    return;
+  flush();
+  m_running = false;
+  wake();
+  m_thread.join();
+}
+
+serial_writer_stats AsyncSerialWriter::stats() const{
+  serial_writer_stats s;
+  s.queue_depth = m_queue.size();
+  s.sent = m_sent;
+  s.dropped = m_dropped;
+  s.coalesced = m_coalesced;
+  s.bytes = m_bytes;
+  return s;
+}
+
+void AsyncSerialWriter::wake(){
+  m_cond.notify_one();
+}
+
+void AsyncSerialWriter::write(const serial_message &msg){
+  m_serial.write(msg.data,msg.len);
+  if(m_on_written)
+    m_on_written(msg.tag);
+  m_sent++;
+  m_bytes += msg.len;
+  m_done++;
+}
+
+void AsyncSerialWriter::run(){
+  serial_message msg;
+  while(m_running){
+    bool idle = true;
+    if(m_latest.update()){
+      const serial_message &latest = m_latest.readBuffer();
+      if(latest.epoch<m_epoch){//a message queued after it replaces it
+        m_coalesced++;
+        m_done++;
+      }
+      else{
+        while(m_written<latest.epoch && m_queue.pop(msg)){//the ones queued before it go first
+          write(msg);
+          m_written = msg.epoch;
+        }
+        write(latest);
+      }
+      idle = false;
+    }
+    while(m_queue.pop(msg)){
+      write(msg);
+      m_written = msg.epoch;
+      idle = false;
+    }
+    if(idle){
+      //the timeout covers a notification sent between the checks above and the wait
+      unique_lock<mutex> lock(m_mutex);
+      m_cond.wait_for(lock,chrono::milliseconds(1));
+    }
+  }
+}
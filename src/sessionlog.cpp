@@ -0,0 +1,238 @@
+#include "sessionlog.h"
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include "aprilvideointerface.h"
+using namespace std;
+
+void packDetection(const AprilTags::TagDetection &d, session_detection &s){
+  memset(&s,0,sizeof(s));
+  s.obs_code = d.obsCode;
+  s.code = d.code;
+  s.id = d.id;
+  s.hamming_distance = d.hammingDistance;
+  s.rotation = d.rotation;
+  s.good = d.good;
+  for(int j = 0;j<4;j++){
+    s.p[j][0] = d.p[j].first;
+    s.p[j][1] = d.p[j].second;
+  }
+  s.cxy[0] = d.cxy.first, s.cxy[1] = d.cxy.second;
+  s.hxy[0] = d.hxy.first, s.hxy[1] = d.hxy.second;
+  s.observed_perimeter = d.observedPerimeter;
+  for(int j = 0;j<9;j++)
+    s.homography[j] = d.homography(j/3,j%3);
+}
+
+void unpackDetection(const session_detection &s, AprilTags::TagDetection &d){
+  d.obsCode = s.obs_code;
+  d.code = s.code;
+  d.id = s.id;
+  d.hammingDistance = s.hamming_distance;
+  d.rotation = s.rotation;
+  d.good = s.good;
+  for(int j = 0;j<4;j++)
+    d.p[j] = make_pair(s.p[j][0],s.p[j][1]);
+  d.cxy = make_pair(s.cxy[0],s.cxy[1]);
+  d.hxy = make_pair(s.hxy[0],s.hxy[1]);
+  d.observedPerimeter = s.observed_perimeter;
+  for(int j = 0;j<9;j++)
+    d.homography(j/3,j%3) = s.homography[j];
+}
+
+SessionWriter::SessionWriter():m_file(NULL),m_compress(false),m_bytes(0){}
+
+SessionWriter::~SessionWriter(){
+  close();
+}
+
+bool SessionWriter::open(const string& path, bool compress){
+  close();
+  m_file = fopen(path.c_str(),"wb");
+  if(!m_file)
+    return false;
+  m_compress = compress;
+  m_bytes = fwrite(SESSION_MAGIC,1,8,m_file);
+  return true;
+}
+
+void SessionWriter::close(){
+  lock_guard<mutex> lock(m_lock);
+  if(!m_file)
+    return;
+  fclose(m_file);
+  m_file = NULL;
+}
+
+void SessionWriter::writeRecord(uint32_t type, long frame_id, double time, const void *a, size_t a_len, const void *b, size_t b_len){
+  lock_guard<mutex> lock(m_lock);
+  if(!m_file)
+    return;
+  session_record_header h;
+  h.type = type;
+  h.length = a_len+b_len;
+  h.frame_id = frame_id;
+  h.time = time;
+  m_bytes += fwrite(&h,1,sizeof(h),m_file);
+  m_bytes += fwrite(a,1,a_len,m_file);
+  if(b_len)
+    m_bytes += fwrite(b,1,b_len,m_file);
+}
+
+void SessionWriter::writeFrame(long frame_id, double t_capture, const cv::Mat &gray){
+  int32_t info[3] = {gray.rows,gray.cols,m_compress ? SESSION_PNG : SESSION_RAW};
+  if(m_compress){
+    cv::imencode(".png",gray,m_buf);
+    writeRecord(SESSION_FRAME,frame_id,t_capture,info,sizeof(info),m_buf.data(),m_buf.size());
+    return;
+  }
+  if(gray.isContinuous()){
+    writeRecord(SESSION_FRAME,frame_id,t_capture,info,sizeof(info),gray.data,gray.total());
+    return;
+  }
+  m_buf.resize(gray.total());
+  for(int r = 0;r<gray.rows;r++)
+    memcpy(&m_buf[r*gray.cols],gray.ptr(r),gray.cols);
+  writeRecord(SESSION_FRAME,frame_id,t_capture,info,sizeof(info),m_buf.data(),m_buf.size());
+}
+
+void SessionWriter::writeDetections(long frame_id, const vector<AprilTags::TagDetection> &dets){
+  uint32_t count = dets.size();
+  m_buf.resize(count*sizeof(session_detection));
+  session_detection *out = (session_detection*)m_buf.data();
+  for(int i = 0;i<count;i++)
+    packDetection(dets[i],out[i]);
+  writeRecord(SESSION_DETECTIONS,frame_id,tic(),&count,sizeof(count),m_buf.data(),m_buf.size());
+}
+
+void SessionWriter::writePoses(long frame_id, const vector<session_pose> &poses){
+  uint32_t count = poses.size();
+  writeRecord(SESSION_POSES,frame_id,tic(),&count,sizeof(count),poses.data(),count*sizeof(session_pose));
+}
+
+void SessionWriter::writeCommands(long frame_id, unsigned char seq, const vector<bot_command> &commands){
+  uint32_t head[2] = {seq,(uint32_t)commands.size()};
+  m_command_buf.resize(commands.size()*sizeof(session_command));
+  session_command *out = (session_command*)m_command_buf.data();
+  for(int i = 0;i<commands.size();i++){
+    out[i].id = commands[i].id;
+    out[i].left = commands[i].left;
+    out[i].right = commands[i].right;
+  }
+  writeRecord(SESSION_COMMANDS,frame_id,tic(),head,sizeof(head),m_command_buf.data(),m_command_buf.size());
+}
+
+SessionReader::SessionReader():m_data(NULL),m_size(0),m_pos(0){}
+
+SessionReader::~SessionReader(){
+  close();
+}
+
+bool SessionReader::open(const string& path){
+  close();
+  int fd = ::open(path.c_str(),O_RDONLY);
+  if(fd<0)
+    return false;
+  struct stat st;
+  if(fstat(fd,&st) != 0 || st.st_size < 8){
+    ::close(fd);
+    return false;
+  }
+  //private writable mapping so that frames handed out can be drawn on without touching the file
+  void *data = mmap(NULL,st.st_size,PROT_READ | PROT_WRITE,MAP_PRIVATE,fd,0);
+  ::close(fd);//the mapping keeps the file open
+  if(data == MAP_FAILED)
+    return false;
+  if(memcmp(data,SESSION_MAGIC,8) != 0){
+    munmap(data,st.st_size);
+    return false;
+  }
+  madvise(data,st.st_size,MADV_SEQUENTIAL);
+  m_data = (unsigned char*)data;
+  m_size = st.st_size;
+  m_pos = 8;
+  return true;
+}
+
+void SessionReader::close(){
+  if(!m_data)
+    return;
+  munmap(m_data,m_size);
+  m_data = NULL;
+  m_size = m_pos = 0;
+}
+
+void SessionReader::rewind(){
+  m_pos = 8;
+}
+
+bool SessionReader::next(session_record &rec){
+  if(!m_data || m_pos+sizeof(session_record_header) > m_size)
+    return false;
+  memcpy(&rec.header,m_data+m_pos,sizeof(session_record_header));
+  size_t end = m_pos+sizeof(session_record_header)+rec.header.length;
+  if(end > m_size)//truncated record at the end
+    return false;
+  rec.payload = m_data+m_pos+sizeof(session_record_header);
+  m_pos = end;
+  return true;
+}
+
+bool SessionReader::nextFrame(cv::Mat &gray, long &frame_id, double &t_capture){
+  session_record rec;
+  while(next(rec)){
+    if(rec.header.type != SESSION_FRAME)
+      continue;
+    frame(rec,gray);
+    frame_id = rec.header.frame_id;
+    t_capture = rec.header.time;
+    return true;
+  }
+  return false;
+}
+
+void SessionReader::frame(const session_record &rec, cv::Mat &gray){
+  int32_t info[3];
+  memcpy(info,rec.payload,sizeof(info));
+  unsigned char *data = (unsigned char*)rec.payload+sizeof(info);
+  if(info[2] == SESSION_PNG){
+    vector<uchar> png(data,data+rec.header.length-sizeof(info));
+    gray = cv::imdecode(png,0);//0 loads as gray scale
+  }
+  else
+    gray = cv::Mat(info[0],info[1],CV_8UC1,data);
+}
+
+void SessionReader::detections(const session_record &rec, vector<AprilTags::TagDetection> &dets){
+  uint32_t count;
+  memcpy(&count,rec.payload,sizeof(count));
+  dets.resize(count);
+  for(int i = 0;i<count;i++){
+    session_detection s;
+    memcpy(&s,rec.payload+sizeof(count)+i*sizeof(s),sizeof(s));
+    unpackDetection(s,dets[i]);
+  }
+}
+
+void SessionReader::poses(const session_record &rec, vector<session_pose> &poses){
+  uint32_t count;
+  memcpy(&count,rec.payload,sizeof(count));
+  poses.resize(count);
+  memcpy(poses.data(),rec.payload+sizeof(count),count*sizeof(session_pose));
+}
+
+void SessionReader::commands(const session_record &rec, unsigned char &seq, vector<bot_command> &commands){
+  uint32_t head[2];
+  memcpy(head,rec.payload,sizeof(head));
+  seq = head[0];
+  commands.resize(head[1]);
+  for(int i = 0;i<head[1];i++){
+    session_command s;
+    memcpy(&s,rec.payload+sizeof(head)+i*sizeof(s),sizeof(s));
+    commands[i].id = s.id;
+    commands[i].left = s.left;
+    commands[i].right = s.right;
+  }
+}
@@ -0,0 +1,169 @@
+#include "telemetry.h"
+#include <cstdarg>
+#include <cstring>
+#include <chrono>
+#include <sys/time.h>
+using namespace std;
+
+static double now(){
+  struct timeval t;
+  gettimeofday(&t, NULL);//same clock as tic()
+  return t.tv_sec + t.tv_usec/1000000.;
+}
+
+static const char *level_names[] = {"debug","info","warn","error"};
+
+Telemetry& Telemetry::instance(){
+  static Telemetry channel;
+  return channel;
+}
+
+static size_t powerOfTwo(int n){
+  size_t p = 1;
+  while(p<n)
+    p <<= 1;
+  return p;
+}
+
+Telemetry::Telemetry(int capacity):m_slots(powerOfTwo(capacity)),m_head(0),m_tail(0),m_dropped(0),m_drained(0),m_running(true),m_out(stdout),m_file(NULL){
+  m_mask = m_slots.size()-1;
+  for(size_t i = 0;i<m_slots.size();i++)
+    m_slots[i].seq.store(i,memory_order_relaxed);
+  m_thread = thread(&Telemetry::drain,this);
+}
+
+Telemetry::~Telemetry(){
+  stop();
+}
+
+bool Telemetry::open(const string &path){
+  FILE *f = NULL;
+  if(!path.empty() && path != "-"){
+    f = fopen(path.c_str(),"w");
+    if(!f)
+      return false;
+  }
+  flush();
+  lock_guard<mutex> lock(m_out_lock);
+  if(m_file)
+    fclose(m_file);
+  m_file = f;
+  m_out = path.empty() ? NULL : (f ? f : stdout);
+  return true;
+}
+
+//bounded multi producer ring: a producer owns a slot once it has moved the head past it, and hands it
+//to the consumer by bumping the slot's sequence, so no producer ever waits for another
+Telemetry::slot* Telemetry::claim(size_t &pos){
+  pos = m_head.load(memory_order_relaxed);
+  while(true){
+    slot &s = m_slots[pos & m_mask];
+    size_t seq = s.seq.load(memory_order_acquire);
+    long diff = (long)seq-(long)pos;
+    if(diff == 0){
+      if(m_head.compare_exchange_weak(pos,pos+1,memory_order_relaxed))
+        return &s;
+    }
+    else if(diff < 0){//the drain thread has not freed this slot yet, the ring is full
+      m_dropped.fetch_add(1,memory_order_relaxed);
+      return NULL;
+    }
+    else
+      pos = m_head.load(memory_order_relaxed);
+  }
+}
+
+void Telemetry::publish(slot *s, size_t pos){
+  s->seq.store(pos+1,memory_order_release);
+}
+
+bool Telemetry::pop(telemetry_record &rec){
+  slot &s = m_slots[m_tail & m_mask];
+  if(s.seq.load(memory_order_acquire) != m_tail+1)
+    return false;
+  rec = s.rec;
+  s.seq.store(m_tail+m_mask+1,memory_order_release);//free for the next lap
+  m_tail++;
+  return true;
+}
+
+void Telemetry::log(int level, const char *format, ...){
+  size_t pos;
+  slot *s = claim(pos);
+  if(!s)
+    return;
+  telemetry_record *rec = &s->rec;
+  rec->time = now();
+  rec->level = level;
+  rec->kind = TELEMETRY_LOG;
+  rec->value = 0;
+  va_list args;
+  va_start(args,format);
+  vsnprintf(rec->text,sizeof(rec->text),format,args);
+  va_end(args);
+  publish(s,pos);
+}
+
+void Telemetry::metric(const char *name, double value){
+  size_t pos;
+  slot *s = claim(pos);
+  if(!s)
+    return;
+  telemetry_record *rec = &s->rec;
+  rec->time = now();
+  rec->level = TELEMETRY_INFO;
+  rec->kind = TELEMETRY_METRIC;
+  rec->value = value;
+  strncpy(rec->text,name,sizeof(rec->text)-1);
+  rec->text[sizeof(rec->text)-1] = 0;
+  publish(s,pos);
+}
+
+void Telemetry::write(const telemetry_record &rec){
+  if(!m_out)
+    return;
+  if(rec.kind == TELEMETRY_METRIC)
+    fprintf(m_out,"%.6f metric %s %g\n",rec.time,rec.text,rec.value);
+  else
+    fprintf(m_out,"%.6f %s %s\n",rec.time,level_names[rec.level],rec.text);
+}
+
+void Telemetry::drain(){
+  telemetry_record rec;
+  while(true){
+    bool running = m_running.load(memory_order_acquire);
+    int n = 0;
+    {
+      lock_guard<mutex> lock(m_out_lock);
+      while(pop(rec)){
+        write(rec);
+        n++;
+      }
+      if(n && m_out)
+        fflush(m_out);
+    }
+    m_drained.fetch_add(n,memory_order_release);
+    if(!running)
+      break;//one last pass after stop() so that nothing published before it is lost
+    if(!n)
+      this_thread::sleep_for(chrono::milliseconds(5));
+  }
+}
+
+void Telemetry::flush(){
+  //every record claimed before this point, dropped records never move the head
+  unsigned long target = m_head.load(memory_order_acquire);
+  while(m_running.load(memory_order_acquire) && m_drained.load(memory_order_acquire) < target)
+    this_thread::sleep_for(chrono::milliseconds(1));
+}
+
+void Telemetry::stop(){
+  if(!m_running.exchange(false))
+    return;
+  m_thread.join();
+  lock_guard<mutex> lock(m_out_lock);
+  if(m_file)
+    fclose(m_file);
+  m_file = NULL;
+  m_out = NULL;
+}
@@ -0,0 +1,181 @@
+#include "v4l2capture.h"
+#include <iostream>
+#include <cstring>
+#include <fcntl.h>
+#include <errno.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/stat.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <linux/videodev2.h>
+#include "aprilvideointerface.h"
+using namespace std;
+
+//ioctl that retries when interrupted by a signal
+static int xioctl(int fd, unsigned long request, void *arg){
+  int r;
+  do{
+    r = ioctl(fd,request,arg);
+  }while(r == -1 && errno == EINTR);
+  return r;
+}
+
+V4L2Capture::V4L2Capture():m_fd(-1),m_file(false),m_width(0),m_height(0),m_file_frame(0),m_frames(0){}
+
+V4L2Capture::~V4L2Capture(){
+  close();
+}
+
+bool V4L2Capture::open(const string& path, int &width, int &height, int buffer_count){
+  close();
+  struct stat st;
+  if(stat(path.c_str(),&st) != 0){
+    cerr << "ERROR: Can't open " << path << ": " << strerror(errno) << endl;
+    return false;
+  }
+  m_file = S_ISREG(st.st_mode);
+  m_fd = ::open(path.c_str(),m_file ? O_RDONLY : O_RDWR);
+  if(m_fd < 0){
+    cerr << "ERROR: Can't open " << path << ": " << strerror(errno) << endl;
+    return false;
+  }
+  m_width = width;
+  m_height = height;
+  bool ok = m_file ? openFile() : openDevice(width,height,buffer_count);
+  if(!ok)
+    close();
+  return ok;
+}
+
+bool V4L2Capture::openFile(){
+  struct stat st;
+  fstat(m_fd,&st);
+  size_t frame_size = (size_t)m_width*m_height*2;
+  if(st.st_size < frame_size){
+    cerr << "ERROR: file holds no complete " << m_width << "x" << m_height << " YUYV frame" << endl;
+    return false;
+  }
+  buffer b;
+  b.length = st.st_size - st.st_size%frame_size;
+  b.start = mmap(NULL,b.length,PROT_READ,MAP_SHARED,m_fd,0);
+  if(b.start == MAP_FAILED){
+    cerr << "ERROR: mmap failed: " << strerror(errno) << endl;
+    return false;
+  }
+  m_buffers.push_back(b);
+  m_file_frame = 0;
+  return true;
+}
+
+bool V4L2Capture::openDevice(int &width, int &height, int buffer_count){
+  struct v4l2_capability cap;
+  if(xioctl(m_fd,VIDIOC_QUERYCAP,&cap) == -1 || !(cap.capabilities & V4L2_CAP_VIDEO_CAPTURE) || !(cap.capabilities & V4L2_CAP_STREAMING)){
+    cerr << "ERROR: device does not support streaming capture" << endl;
+    return false;
+  }
+  struct v4l2_format fmt;
+  memset(&fmt,0,sizeof(fmt));
+  fmt.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+  fmt.fmt.pix.width = width;
+  fmt.fmt.pix.height = height;
+  fmt.fmt.pix.pixelformat = V4L2_PIX_FMT_YUYV;
+  fmt.fmt.pix.field = V4L2_FIELD_NONE;
+  if(xioctl(m_fd,VIDIOC_S_FMT,&fmt) == -1 || fmt.fmt.pix.pixelformat != V4L2_PIX_FMT_YUYV){
+    cerr << "ERROR: device does not deliver YUYV" << endl;
+    return false;
+  }
+  width = m_width = fmt.fmt.pix.width;//the driver may have picked the closest size it supports
+  height = m_height = fmt.fmt.pix.height;
+  if(fmt.fmt.pix.bytesperline != (unsigned)m_width*2){
+    cerr << "ERROR: padded YUYV lines are not supported" << endl;
+    return false;
+  }
+
+  struct v4l2_requestbuffers req;
+  memset(&req,0,sizeof(req));
+  req.count = buffer_count;
+  req.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+  req.memory = V4L2_MEMORY_MMAP;
+  if(xioctl(m_fd,VIDIOC_REQBUFS,&req) == -1 || req.count < 2){
+    cerr << "ERROR: can't get mmap buffers from the device" << endl;
+    return false;
+  }
+  for(unsigned i = 0;i<req.count;i++){
+    struct v4l2_buffer buf;
+    memset(&buf,0,sizeof(buf));
+    buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    buf.memory = V4L2_MEMORY_MMAP;
+    buf.index = i;
+    if(xioctl(m_fd,VIDIOC_QUERYBUF,&buf) == -1)
+      return false;
+    buffer b;
+    b.length = buf.length;
+    b.start = mmap(NULL,buf.length,PROT_READ | PROT_WRITE,MAP_SHARED,m_fd,buf.m.offset);
+    if(b.start == MAP_FAILED)
+      return false;
+    m_buffers.push_back(b);
+    if(xioctl(m_fd,VIDIOC_QBUF,&buf) == -1)
+      return false;
+  }
+  enum v4l2_buf_type type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+  if(xioctl(m_fd,VIDIOC_STREAMON,&type) == -1){
+    cerr << "ERROR: can't start streaming: " << strerror(errno) << endl;
+    return false;
+  }
+  return true;
+}
+
+void V4L2Capture::close(){
+  if(m_fd < 0)
+    return;
+  if(!m_file){
+    enum v4l2_buf_type type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    xioctl(m_fd,VIDIOC_STREAMOFF,&type);
+  }
+  for(int i = 0;i<m_buffers.size();i++)
+    munmap(m_buffers[i].start,m_buffers[i].length);
+  m_buffers.clear();
+  ::close(m_fd);
+  m_fd = -1;
+}
+
+bool V4L2Capture::grab(cv::Mat &gray, double &timestamp){
+  if(m_fd < 0)
+    return false;
+  if(m_file){
+    size_t frame_size = (size_t)m_width*m_height*2;
+    size_t frames = m_buffers[0].length/frame_size;
+    unsigned char *data = (unsigned char*)m_buffers[0].start + (m_file_frame%frames)*frame_size;
+    m_file_frame++;
+    //the header points into the file, extractChannel copies the Y bytes out
+    cv::Mat yuyv(m_height,m_width,CV_8UC2,data);
+    cv::extractChannel(yuyv,gray,0);
+    timestamp = tic();
+    m_frames++;
+    return true;
+  }
+
+  struct v4l2_buffer buf;
+  memset(&buf,0,sizeof(buf));
+  buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+  buf.memory = V4L2_MEMORY_MMAP;
+  if(xioctl(m_fd,VIDIOC_DQBUF,&buf) == -1){//blocks until the driver has filled a buffer
+    cerr << "ERROR: can't dequeue frame: " << strerror(errno) << endl;
+    return false;
+  }
+  //in YUYV every even byte is a luminance sample, so the Y plane is channel 0 of a two channel image
+  cv::Mat yuyv(m_height,m_width,CV_8UC2,m_buffers[buf.index].start);
+  cv::extractChannel(yuyv,gray,0);
+  //the driver stamps frames on the monotonic clock, shift it onto the wall clock used by tic()
+  double t = buf.timestamp.tv_sec + buf.timestamp.tv_usec/1000000.;
+  if(buf.flags & V4L2_BUF_FLAG_TIMESTAMP_MONOTONIC){
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC,&now);
+    t += tic() - (now.tv_sec + now.tv_nsec/1000000000.);
+  }
+  timestamp = t;
+  xioctl(m_fd,VIDIOC_QBUF,&buf);//hand the buffer back to the driver
+  m_frames++;
+  return true;
+}
@@ -0,0 +1,60 @@
+#include "workerpool.h"
+using namespace std;
+
+void WorkerPool::resize(int threads){
+  if(threads<1)
+    threads = 1;
+  if(threads-1 == m_threads.size())
+    return;
+  {
+    lock_guard<mutex> lock(m_lock);
+    m_stop = true;
+  }
+  m_wake.notify_all();
+  for(int i = 0;i<m_threads.size();i++)
+    m_threads[i].join();
+  m_threads.clear();
+  m_stop = false;
+  for(int i = 1;i<threads;i++)//given the generation now, one read once started could already be the first job's
+    m_threads.push_back(thread(&WorkerPool::loop,this,m_generation));
+}
+
+void WorkerPool::work(){
+  for(int k;(k = m_next++)<m_n;)
+    (*m_job)(k);
+}
+
+void WorkerPool::loop(unsigned seen){
+  unique_lock<mutex> lock(m_lock);
+  while(true){
+    m_wake.wait(lock,[&](){ return m_stop || m_generation != seen; });
+    if(m_stop)
+      return;
+    seen = m_generation;
+    lock.unlock();
+    work();
+    lock.lock();
+    if(--m_busy == 0)
+      m_done.notify_one();
+  }
+}
+
+void WorkerPool::run(int n, const function<void(int)> &f){
+  if(m_threads.empty() || n<2){//waking the workers costs more than a single call
+    for(int k = 0;k<n;k++)
+      f(k);
+    return;
+  }
+  {
+    lock_guard<mutex> lock(m_lock);
+    m_job = &f;
+    m_n = n;
+    m_next = 0;
+    m_busy = m_threads.size();
+    m_generation++;
+  }
+  m_wake.notify_all();
+  work();
+  unique_lock<mutex> lock(m_lock);
+  m_done.wait(lock,[&](){ return m_busy == 0; });
+}
@@ -0,0 +1,27 @@
+#include "worldmapping.h"
+using namespace std;
+
+void HomographyMapping::pixelToWorld(double x,double y,double &xd,double &yd){
+  Eigen::Vector3d p = H*Eigen::Vector3d(x,y,1);
+  xd = p(0)/p(2);
+  yd = p(1)/p(2);
+}
+
+void HomographyMapping::fit(WorldMapping &mapping, int width, int height){
+  double px[4] = {0,(double)width,(double)width,0}, py[4] = {0,0,(double)height,(double)height};
+  //two equations per corner in the eight unknowns of H, with H(2,2) fixed to 1
+  Eigen::Matrix<double,8,8> A;
+  Eigen::Matrix<double,8,1> b;
+  for(int i = 0;i<4;i++){
+    double x = px[i], y = py[i], wx, wy;
+    mapping.pixelToWorld(x,y,wx,wy);
+    A.row(2*i) << x,y,1,0,0,0,-x*wx,-y*wx;
+    A.row(2*i+1) << 0,0,0,x,y,1,-x*wy,-y*wy;
+    b(2*i) = wx;
+    b(2*i+1) = wy;
+  }
+  Eigen::Matrix<double,8,1> h = A.colPivHouseholderQr().solve(b);
+  H << h(0),h(1),h(2),
+       h(3),h(4),h(5),
+       h(6),h(7),1;
+}